@@ -0,0 +1,473 @@
+#include "Allocator.hpp"
+
+static uint32_t floorLog2(VkDeviceSize value) {
+    return 63 - (uint32_t)__builtin_clzll(value);
+}
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1)/alignment*alignment;
+}
+
+void TlsfBlock::init(VkDeviceSize blockSize) {
+    size = blockSize;
+    usedBytes = 0;
+    allocationCount = 0;
+    nodes.clear();
+    unusedNodes.clear();
+    flBitmap = 0;
+    for (uint32_t fl=0; fl<FL_COUNT; fl++) {
+        slBitmap[fl] = 0;
+        for (uint32_t sl=0; sl<SL_COUNT; sl++) {
+            freeHeads[fl][sl] = NONE;
+        }
+    }
+    uint32_t node = newNode();
+    nodes[node] = Node{
+        .offset = 0,
+        .size = blockSize,
+        .prevPhys = NONE,
+        .nextPhys = NONE,
+        .prevFree = NONE,
+        .nextFree = NONE,
+        .free = true
+    };
+    insertFree(node);
+}
+void TlsfBlock::mapping(VkDeviceSize rangeSize, uint32_t& fl, uint32_t& sl) {
+    if (rangeSize < (1ull<<MIN_LOG2)) {
+        fl = 0;
+        sl = (uint32_t)(rangeSize >> (MIN_LOG2 - SL_LOG2));
+    } else {
+        uint32_t f = floorLog2(rangeSize);
+        sl = (uint32_t)(rangeSize >> (f - SL_LOG2)) ^ SL_COUNT;
+        fl = f - MIN_LOG2 + 1;
+    }
+}
+uint32_t TlsfBlock::findFree(VkDeviceSize rangeSize) {
+    // round up to the next size class so every range in the class found is large enough
+    if (rangeSize < (1ull<<MIN_LOG2)) {
+        rangeSize += (1ull << (MIN_LOG2 - SL_LOG2)) - 1;
+    } else {
+        rangeSize += (1ull << (floorLog2(rangeSize) - SL_LOG2)) - 1;
+    }
+    uint32_t fl;
+    uint32_t sl;
+    mapping(rangeSize, fl, sl);
+    if (fl >= FL_COUNT) {
+        return NONE;
+    }
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (slMap == 0) {
+        uint64_t flMap = flBitmap & (~0ull << (fl+1));
+        if (flMap == 0) {
+            return NONE;
+        }
+        fl = (uint32_t)__builtin_ctzll(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = (uint32_t)__builtin_ctz(slMap);
+    return freeHeads[fl][sl];
+}
+void TlsfBlock::insertFree(uint32_t node) {
+    uint32_t fl;
+    uint32_t sl;
+    mapping(nodes[node].size, fl, sl);
+    uint32_t head = freeHeads[fl][sl];
+    nodes[node].prevFree = NONE;
+    nodes[node].nextFree = head;
+    if (head != NONE) {
+        nodes[head].prevFree = node;
+    }
+    freeHeads[fl][sl] = node;
+    slBitmap[fl] |= 1u << sl;
+    flBitmap |= 1ull << fl;
+}
+void TlsfBlock::removeFree(uint32_t node) {
+    uint32_t fl;
+    uint32_t sl;
+    mapping(nodes[node].size, fl, sl);
+    uint32_t prev = nodes[node].prevFree;
+    uint32_t next = nodes[node].nextFree;
+    if (prev != NONE) {
+        nodes[prev].nextFree = next;
+    } else {
+        freeHeads[fl][sl] = next;
+    }
+    if (next != NONE) {
+        nodes[next].prevFree = prev;
+    }
+    if (freeHeads[fl][sl] == NONE) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (slBitmap[fl] == 0) {
+            flBitmap &= ~(1ull << fl);
+        }
+    }
+}
+uint32_t TlsfBlock::newNode() {
+    if (!unusedNodes.empty()) {
+        uint32_t node = unusedNodes.back();
+        unusedNodes.pop_back();
+        return node;
+    }
+    nodes.push_back(Node{});
+    return (uint32_t)nodes.size()-1;
+}
+uint32_t TlsfBlock::splitFront(uint32_t node, VkDeviceSize frontSize) {
+    uint32_t front = newNode();
+    nodes[front] = Node{
+        .offset = nodes[node].offset,
+        .size = frontSize,
+        .prevPhys = nodes[node].prevPhys,
+        .nextPhys = node,
+        .prevFree = NONE,
+        .nextFree = NONE,
+        .free = false
+    };
+    if (nodes[node].prevPhys != NONE) {
+        nodes[nodes[node].prevPhys].nextPhys = front;
+    }
+    nodes[node].prevPhys = front;
+    nodes[node].offset += frontSize;
+    nodes[node].size -= frontSize;
+    return front;
+}
+uint32_t TlsfBlock::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment) {
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+    // searching for the worst case padding keeps the lookup O(1)
+    uint32_t node = findFree(allocationSize + alignment - 1);
+    if (node == NONE) {
+        return NONE;
+    }
+    removeFree(node);
+    VkDeviceSize padding = alignUp(nodes[node].offset, alignment) - nodes[node].offset;
+    if (padding > 0) {
+        // the physical neighbour before a free range is always in use, so the padding can't merge
+        uint32_t front = splitFront(node, padding);
+        nodes[front].free = true;
+        insertFree(front);
+    }
+    if (nodes[node].size > allocationSize) {
+        uint32_t rest = newNode();
+        nodes[rest] = Node{
+            .offset = nodes[node].offset + allocationSize,
+            .size = nodes[node].size - allocationSize,
+            .prevPhys = node,
+            .nextPhys = nodes[node].nextPhys,
+            .prevFree = NONE,
+            .nextFree = NONE,
+            .free = true
+        };
+        if (nodes[node].nextPhys != NONE) {
+            nodes[nodes[node].nextPhys].prevPhys = rest;
+        }
+        nodes[node].nextPhys = rest;
+        nodes[node].size = allocationSize;
+        insertFree(rest);
+    }
+    nodes[node].free = false;
+    usedBytes += allocationSize;
+    allocationCount++;
+    return node;
+}
+void TlsfBlock::free(uint32_t node) {
+    usedBytes -= nodes[node].size;
+    allocationCount--;
+    nodes[node].free = true;
+    uint32_t prev = nodes[node].prevPhys;
+    if (prev != NONE && nodes[prev].free) {
+        removeFree(prev);
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].nextPhys = nodes[node].nextPhys;
+        if (nodes[node].nextPhys != NONE) {
+            nodes[nodes[node].nextPhys].prevPhys = prev;
+        }
+        unusedNodes.push_back(node);
+        node = prev;
+    }
+    uint32_t next = nodes[node].nextPhys;
+    if (next != NONE && nodes[next].free) {
+        removeFree(next);
+        nodes[node].size += nodes[next].size;
+        nodes[node].nextPhys = nodes[next].nextPhys;
+        if (nodes[next].nextPhys != NONE) {
+            nodes[nodes[next].nextPhys].prevPhys = node;
+        }
+        unusedNodes.push_back(next);
+    }
+    insertFree(node);
+}
+VkDeviceSize TlsfBlock::getLargestFree() {
+    if (flBitmap == 0) {
+        return 0;
+    }
+    uint32_t fl = 63 - (uint32_t)__builtin_clzll(flBitmap);
+    uint32_t sl = 31 - (uint32_t)__builtin_clz(slBitmap[fl]);
+    VkDeviceSize largest = 0;
+    for (uint32_t node = freeHeads[fl][sl]; node != NONE; node = nodes[node].nextFree) {
+        largest = std::max(largest, nodes[node].size);
+    }
+    return largest;
+}
+
+void MemoryAllocator::init(VkDevice dev, VkPhysicalDevice physicalDevice, VkDeviceSize defaultBlockSize) {
+    device = dev;
+    blockSize = defaultBlockSize;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    nonCoherentAtomSize = props.limits.nonCoherentAtomSize;
+    pools.resize(memProps.memoryTypeCount*2);
+    for (uint32_t i=0; i<memProps.memoryTypeCount; i++) {
+        pools[i*2].memoryType = i;
+        pools[i*2].linear = false;
+        pools[i*2+1].memoryType = i;
+        pools[i*2+1].linear = true;
+    }
+}
+void MemoryAllocator::destroy() {
+    for (auto& pool: pools) {
+        for (auto& block: pool.blocks) {
+            if (block) {
+                vkFreeMemory(device, block->memory, nullptr);
+            }
+        }
+        pool.blocks.clear();
+    }
+    for (auto& allocation: dedicatedAllocations) {
+        vkFreeMemory(device, allocation.memory, nullptr);
+    }
+    dedicatedAllocations.clear();
+}
+Allocation MemoryAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags memProperties) {
+    VkMemoryDedicatedRequirements dedicatedRequirements{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+        .pNext = nullptr
+    };
+    VkMemoryRequirements2 memRequirements{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedRequirements
+    };
+    VkBufferMemoryRequirementsInfo2 requirementsInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+        .pNext = nullptr,
+        .buffer = buffer
+    };
+    vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    Allocation allocation = allocate(memRequirements.memoryRequirements, memProperties, true, dedicated, buffer, VK_NULL_HANDLE);
+    VK_CHECK(vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset));
+    return allocation;
+}
+Allocation MemoryAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags memProperties) {
+    VkMemoryDedicatedRequirements dedicatedRequirements{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+        .pNext = nullptr
+    };
+    VkMemoryRequirements2 memRequirements{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedRequirements
+    };
+    VkImageMemoryRequirementsInfo2 requirementsInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+        .pNext = nullptr,
+        .image = image
+    };
+    vkGetImageMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+    bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    Allocation allocation = allocate(memRequirements.memoryRequirements, memProperties, false, dedicated, VK_NULL_HANDLE, image);
+    VK_CHECK(vkBindImageMemory(device, image, allocation.memory, allocation.offset));
+    return allocation;
+}
+Allocation MemoryAllocator::allocate(VkMemoryRequirements memRequirements, VkMemoryPropertyFlags memProperties, bool linear, 
+    bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage) {
+    uint32_t memoryType = getMemoryTypeIndex(memRequirements.memoryTypeBits, memProperties);
+    if (dedicated || memRequirements.size > blockSize/2) {
+        return allocateDedicated(memRequirements, memoryType, linear, dedicatedBuffer, dedicatedImage);
+    }
+    VkMemoryPropertyFlags typeFlags = memProps.memoryTypes[memoryType].propertyFlags;
+    VkDeviceSize alignment = memRequirements.alignment;
+    VkDeviceSize size = memRequirements.size;
+    // keep flush/invalidate ranges of non-coherent memory from touching a neighbour's atoms
+    if ((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        alignment = std::max(alignment, nonCoherentAtomSize);
+        size = alignUp(size, nonCoherentAtomSize);
+    }
+    uint32_t poolIndex = memoryType*2 + (linear ? 1 : 0);
+    Pool& pool = pools[poolIndex];
+    std::optional<uint32_t> emptySlot;
+    for (uint32_t i=0; i<pool.blocks.size(); i++) {
+        if (!pool.blocks[i]) {
+            emptySlot = i;
+            continue;
+        }
+        uint32_t node = pool.blocks[i]->tlsf.allocate(size, alignment);
+        if (node != TlsfBlock::NONE) {
+            Block& block = *pool.blocks[i];
+            VkDeviceSize offset = block.tlsf.nodes[node].offset;
+            return Allocation{
+                .memory = block.memory,
+                .offset = offset,
+                .size = size,
+                .mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr,
+                .pool = poolIndex,
+                .block = i,
+                .node = node
+            };
+        }
+    }
+    auto block = std::make_unique<Block>();
+    block->memory = allocateMemory(blockSize, memoryType, linear, VK_NULL_HANDLE, VK_NULL_HANDLE);
+    block->mapped = nullptr;
+    if (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped));
+    }
+    block->tlsf.init(blockSize);
+    uint32_t node = block->tlsf.allocate(size, alignment);
+    VkDeviceSize offset = block->tlsf.nodes[node].offset;
+    void* mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+    VkDeviceMemory memory = block->memory;
+    uint32_t blockIndex;
+    if (emptySlot.has_value()) {
+        blockIndex = emptySlot.value();
+        pool.blocks[blockIndex] = std::move(block);
+    } else {
+        blockIndex = (uint32_t)pool.blocks.size();
+        pool.blocks.push_back(std::move(block));
+    }
+    return Allocation{
+        .memory = memory,
+        .offset = offset,
+        .size = size,
+        .mapped = mapped,
+        .pool = poolIndex,
+        .block = blockIndex,
+        .node = node
+    };
+}
+Allocation MemoryAllocator::allocateDedicated(VkMemoryRequirements memRequirements, uint32_t memoryType, bool linear,
+    VkBuffer dedicatedBuffer, VkImage dedicatedImage) {
+    Allocation allocation{
+        .memory = allocateMemory(memRequirements.size, memoryType, linear, dedicatedBuffer, dedicatedImage),
+        .offset = 0,
+        .size = memRequirements.size,
+        .mapped = nullptr,
+        .pool = memoryType*2 + (linear ? 1 : 0),
+        .block = TlsfBlock::NONE,
+        .node = TlsfBlock::NONE
+    };
+    if (memProps.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped));
+    }
+    dedicatedAllocations.push_back(allocation);
+    dedicatedBytes += allocation.size;
+    return allocation;
+}
+VkDeviceMemory MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, bool linear, 
+    VkBuffer dedicatedBuffer, VkImage dedicatedImage) {
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .image = dedicatedImage,
+        .buffer = dedicatedBuffer
+    };
+    // every buffer block may back a buffer that is accessed through its device address
+    VkMemoryAllocateFlagsInfo allocateFlagsInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+        .pNext = (dedicatedBuffer != VK_NULL_HANDLE || dedicatedImage != VK_NULL_HANDLE) ? &dedicatedInfo : nullptr,
+        .flags = linear ? (VkMemoryAllocateFlags)VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT : 0,
+        .deviceMask = 0
+    };
+    VkMemoryAllocateInfo allocateInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &allocateFlagsInfo,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType
+    };
+    VkDeviceMemory memory;
+    VK_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &memory));
+    reservedBytes += size;
+    peakReservedBytes = std::max(peakReservedBytes, reservedBytes);
+    return memory;
+}
+void MemoryAllocator::free(Allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    if (allocation.block == TlsfBlock::NONE) {
+        for (size_t i=0; i<dedicatedAllocations.size(); i++) {
+            if (dedicatedAllocations[i].memory == allocation.memory) {
+                dedicatedAllocations[i] = dedicatedAllocations.back();
+                dedicatedAllocations.pop_back();
+                break;
+            }
+        }
+        vkFreeMemory(device, allocation.memory, nullptr);
+        dedicatedBytes -= allocation.size;
+        reservedBytes -= allocation.size;
+    } else {
+        Pool& pool = pools[allocation.pool];
+        std::unique_ptr<Block>& block = pool.blocks[allocation.block];
+        block->tlsf.free(allocation.node);
+        // keep one empty block around per pool so alternating alloc/free doesn't thrash vkAllocateMemory
+        if (block->tlsf.isEmpty()) {
+            uint32_t liveBlocks = 0;
+            for (const auto& other: pool.blocks) {
+                liveBlocks += other ? 1 : 0;
+            }
+            if (liveBlocks > 1) {
+                vkFreeMemory(device, block->memory, nullptr);
+                reservedBytes -= block->tlsf.size;
+                block.reset();
+            }
+        }
+    }
+    allocation = Allocation{};
+}
+VkMappedMemoryRange MemoryAllocator::getMappedRange(const Allocation& allocation) {
+    return VkMappedMemoryRange{
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext = nullptr,
+        .memory = allocation.memory,
+        .offset = allocation.offset,
+        .size = allocation.block == TlsfBlock::NONE ? VK_WHOLE_SIZE : allocation.size
+    };
+}
+void MemoryAllocator::invalidate(const Allocation& allocation) {
+    VkMappedMemoryRange range = getMappedRange(allocation);
+    VK_CHECK(vkInvalidateMappedMemoryRanges(device, 1, &range));
+}
+void MemoryAllocator::flush(const Allocation& allocation) {
+    VkMappedMemoryRange range = getMappedRange(allocation);
+    VK_CHECK(vkFlushMappedMemoryRanges(device, 1, &range));
+}
+AllocatorStats MemoryAllocator::getStats() {
+    AllocatorStats stats;
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFree = 0;
+    for (auto& pool: pools) {
+        for (auto& block: pool.blocks) {
+            if (!block) {
+                continue;
+            }
+            stats.blockCount++;
+            stats.bytesUsed += block->tlsf.usedBytes;
+            stats.allocationCount += block->tlsf.allocationCount;
+            freeBytes += block->tlsf.size - block->tlsf.usedBytes;
+            largestFree = std::max(largestFree, block->tlsf.getLargestFree());
+        }
+    }
+    stats.dedicatedCount = (uint32_t)dedicatedAllocations.size();
+    stats.allocationCount += stats.dedicatedCount;
+    stats.bytesUsed += dedicatedBytes;
+    stats.bytesReserved = reservedBytes;
+    stats.peakBytesReserved = peakReservedBytes;
+    stats.fragmentation = freeBytes > 0 ? 1.0 - (double)largestFree/freeBytes : 0.0;
+    return stats;
+}
+uint32_t MemoryAllocator::getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags memProperties) {
+    for (uint32_t i=0; i<memProps.memoryTypeCount; i++) {
+        if ((typeFilter & (1<<i)) && (memProps.memoryTypes[i].propertyFlags & memProperties)==memProperties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("VK Error: no suitable memory type for allocation");
+}
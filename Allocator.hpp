@@ -0,0 +1,115 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+
+// Two-level segregated fit allocator over one range of device memory. Free ranges are kept
+// in size-class lists indexed by two bitmaps, so allocate and free are O(1) and neighbouring
+// free ranges are merged immediately.
+struct TlsfBlock {
+    static constexpr uint32_t SL_LOG2 = 5;
+    static constexpr uint32_t SL_COUNT = 1<<SL_LOG2;
+    static constexpr uint32_t MIN_LOG2 = 8;
+    static constexpr uint32_t FL_COUNT = 40;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t prevPhys;
+        uint32_t nextPhys;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool free;
+    };
+
+    void init(VkDeviceSize blockSize);
+    // returns the node owning the allocation, NONE when no free range fits
+    uint32_t allocate(VkDeviceSize size, VkDeviceSize alignment);
+    void free(uint32_t node);
+    VkDeviceSize getLargestFree();
+    bool isEmpty() { return usedBytes == 0; }
+
+    void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+    uint32_t findFree(VkDeviceSize size);
+    void insertFree(uint32_t node);
+    void removeFree(uint32_t node);
+    uint32_t newNode();
+    uint32_t splitFront(uint32_t node, VkDeviceSize size);
+
+    VkDeviceSize size = 0;
+    VkDeviceSize usedBytes = 0;
+    uint32_t allocationCount = 0;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint64_t flBitmap = 0;
+    uint32_t slBitmap[FL_COUNT] = {};
+    uint32_t freeHeads[FL_COUNT][SL_COUNT];
+};
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // persistently mapped pointer at `offset`, null for memory that isn't host visible
+    void* mapped = nullptr;
+    uint32_t pool = 0;
+    // NONE for dedicated allocations
+    uint32_t block = TlsfBlock::NONE;
+    uint32_t node = TlsfBlock::NONE;
+};
+
+struct AllocatorStats {
+    VkDeviceSize bytesUsed = 0;
+    VkDeviceSize bytesReserved = 0;
+    VkDeviceSize peakBytesReserved = 0;
+    uint32_t allocationCount = 0;
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    // 1 - largest free range / total free bytes over all blocks, 0 when free space is contiguous
+    double fragmentation = 0.0;
+};
+
+// Sub-allocates buffers and images from large per-memory-type blocks. Buffers and images
+// live in separate pools so linear and optimal resources never share a block, which keeps
+// bufferImageGranularity from ever applying. Large or driver-preferred resources get a
+// dedicated vkAllocateMemory.
+struct MemoryAllocator {
+    struct Block {
+        VkDeviceMemory memory;
+        void* mapped;
+        TlsfBlock tlsf;
+    };
+    struct Pool {
+        uint32_t memoryType;
+        bool linear;
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    void init(VkDevice dev, VkPhysicalDevice physicalDevice, VkDeviceSize defaultBlockSize);
+    void destroy();
+    Allocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags memProperties);
+    Allocation allocateImage(VkImage image, VkMemoryPropertyFlags memProperties);
+    void free(Allocation& allocation);
+    void invalidate(const Allocation& allocation);
+    void flush(const Allocation& allocation);
+    AllocatorStats getStats();
+
+    Allocation allocate(VkMemoryRequirements memRequirements, VkMemoryPropertyFlags memProperties, bool linear, 
+        bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage);
+    Allocation allocateDedicated(VkMemoryRequirements memRequirements, uint32_t memoryType, bool linear,
+        VkBuffer dedicatedBuffer, VkImage dedicatedImage);
+    VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, bool linear, 
+        VkBuffer dedicatedBuffer, VkImage dedicatedImage);
+    uint32_t getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags memProperties);
+    VkMappedMemoryRange getMappedRange(const Allocation& allocation);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memProps{};
+    VkDeviceSize blockSize = 0;
+    VkDeviceSize nonCoherentAtomSize = 1;
+    std::vector<Pool> pools;
+    std::vector<Allocation> dedicatedAllocations;
+    VkDeviceSize dedicatedBytes = 0;
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize peakReservedBytes = 0;
+};
@@ -0,0 +1,231 @@
+#include "Culling.hpp"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// the point of every object one plane is tested against
+struct PlaneInput {
+    const float* x;
+    const float* y;
+    const float* z;
+};
+// writes the visible indices of [begin, end) to out and returns how many there are,
+// out has room for end-begin indices; radius is null for boxes
+using RangeKernel = size_t(*)(const PlaneInput inputs[6], const float* radius, const Frustum& frustum, 
+    size_t begin, size_t end, uint32_t* out);
+
+// every kernel sums in the same order and without FMA, so they agree to the bit
+template<bool hasRadius>
+size_t cullRangeScalar(const PlaneInput inputs[6], const float* radius, const Frustum& frustum, 
+    size_t begin, size_t end, uint32_t* out) {
+    size_t count = 0;
+    for (size_t i=begin; i<end; i++) {
+        bool inside = true;
+        for (int p=0; p<6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = plane.x*inputs[p].x[i] + plane.y*inputs[p].y[i] + plane.z*inputs[p].z[i] + plane.w;
+            if constexpr (hasRadius) {
+                distance += radius[i];
+            }
+            inside = inside && distance >= 0.0f;
+        }
+        // branchless compaction: always write, only advance past visible objects
+        out[count] = (uint32_t)i;
+        count += inside;
+    }
+    return count;
+}
+
+#if defined(__x86_64__)
+template<bool hasRadius>
+size_t cullRangeSse(const PlaneInput inputs[6], const float* radius, const Frustum& frustum, 
+    size_t begin, size_t end, uint32_t* out) {
+    size_t count = 0;
+    size_t i = begin;
+    for (; i+4<=end; i+=4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p=0; p<6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            __m128 distance = _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(inputs[p].x + i));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(inputs[p].y + i)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(inputs[p].z + i)));
+            distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+            if constexpr (hasRadius) {
+                distance = _mm_add_ps(distance, _mm_loadu_ps(radius + i));
+            }
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+        for (uint32_t lane=0; lane<4; lane++) {
+            out[count] = (uint32_t)(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+    return count + cullRangeScalar<hasRadius>(inputs, radius, frustum, i, end, out + count);
+}
+template<bool hasRadius>
+__attribute__((target("avx2")))
+size_t cullRangeAvx2(const PlaneInput inputs[6], const float* radius, const Frustum& frustum, 
+    size_t begin, size_t end, uint32_t* out) {
+    size_t count = 0;
+    size_t i = begin;
+    for (; i+8<=end; i+=8) {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p=0; p<6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            __m256 distance = _mm256_mul_ps(_mm256_set1_ps(plane.x), _mm256_loadu_ps(inputs[p].x + i));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.y), _mm256_loadu_ps(inputs[p].y + i)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), _mm256_loadu_ps(inputs[p].z + i)));
+            distance = _mm256_add_ps(distance, _mm256_set1_ps(plane.w));
+            if constexpr (hasRadius) {
+                distance = _mm256_add_ps(distance, _mm256_loadu_ps(radius + i));
+            }
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+        for (uint32_t lane=0; lane<8; lane++) {
+            out[count] = (uint32_t)(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+    return count + cullRangeScalar<hasRadius>(inputs, radius, frustum, i, end, out + count);
+}
+#endif
+
+template<bool hasRadius>
+RangeKernel getRangeKernel(CullKernel kernel) {
+#if defined(__x86_64__)
+    if (kernel == CullKernel::Avx2) {
+        return cullRangeAvx2<hasRadius>;
+    }
+    if (kernel == CullKernel::Sse) {
+        return cullRangeSse<hasRadius>;
+    }
+#endif
+    return cullRangeScalar<hasRadius>;
+}
+
+void cullObjects(RangeKernel kernel, const PlaneInput inputs[6], const float* radius, size_t objectCount, 
+    const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool* pool) {
+    visible.resize(objectCount);
+    if (pool == nullptr || pool->getThreadCount() < 2 || objectCount < CULL_PARALLEL_MIN_OBJECTS) {
+        visible.resize(kernel(inputs, radius, frustum, 0, objectCount, visible.data()));
+        return;
+    }
+    // a few chunks per thread even out the load, each one compacts into the start of its own range
+    size_t chunkSize = std::max<size_t>((objectCount + pool->getThreadCount()*4 - 1)/(pool->getThreadCount()*4), 
+        CULL_PARALLEL_MIN_OBJECTS/4);
+    chunkSize = (chunkSize + 7)/8*8;
+    size_t chunkCount = (objectCount + chunkSize - 1)/chunkSize;
+    std::vector<size_t> counts(chunkCount);
+    for (size_t chunk=0; chunk<chunkCount; chunk++) {
+        pool->submit([=, &counts, &visible] {
+            size_t begin = chunk*chunkSize;
+            size_t end = std::min(begin + chunkSize, objectCount);
+            counts[chunk] = kernel(inputs, radius, frustum, begin, end, visible.data() + begin);
+        });
+    }
+    pool->wait();
+    size_t total = 0;
+    for (size_t chunk=0; chunk<chunkCount; chunk++) {
+        memmove(visible.data() + total, visible.data() + chunk*chunkSize, counts[chunk]*sizeof(uint32_t));
+        total += counts[chunk];
+    }
+    visible.resize(total);
+}
+
+}
+
+Frustum getFrustum(const glm::mat4& clip) {
+    // each plane is the sum or difference of two rows of the clip matrix
+    glm::vec4 rows[4];
+    for (int i=0; i<4; i++) {
+        rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+    }
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    for (auto& plane: frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void SphereBounds::resize(size_t count) {
+    centerX.resize(count);
+    centerY.resize(count);
+    centerZ.resize(count);
+    radius.resize(count);
+}
+void SphereBounds::set(size_t i, const float center[3], float sphereRadius) {
+    centerX[i] = center[0];
+    centerY[i] = center[1];
+    centerZ[i] = center[2];
+    radius[i] = sphereRadius;
+}
+void BoxBounds::resize(size_t count) {
+    minX.resize(count);
+    minY.resize(count);
+    minZ.resize(count);
+    maxX.resize(count);
+    maxY.resize(count);
+    maxZ.resize(count);
+}
+void BoxBounds::set(size_t i, const float min[3], const float max[3]) {
+    minX[i] = min[0];
+    minY[i] = min[1];
+    minZ[i] = min[2];
+    maxX[i] = max[0];
+    maxY[i] = max[1];
+    maxZ[i] = max[2];
+}
+
+CullKernel getCullKernel() {
+#if defined(__x86_64__)
+    // SSE2 is part of x86-64, AVX2 has to be asked for
+    static const CullKernel kernel = __builtin_cpu_supports("avx2") ? CullKernel::Avx2 : CullKernel::Sse;
+    return kernel;
+#else
+    return CullKernel::Scalar;
+#endif
+}
+const char* getCullKernelName(CullKernel kernel) {
+    switch (kernel) {
+    case CullKernel::Scalar:
+        return "scalar";
+    case CullKernel::Sse:
+        return "sse";
+    case CullKernel::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void cullSpheres(const SphereBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, 
+    ThreadPool* pool, CullKernel kernel) {
+    PlaneInput inputs[6];
+    for (auto& input: inputs) {
+        input = PlaneInput{bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data()};
+    }
+    cullObjects(getRangeKernel<true>(kernel), inputs, bounds.radius.data(), bounds.size(), frustum, visible, pool);
+}
+void cullBoxes(const BoxBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, 
+    ThreadPool* pool, CullKernel kernel) {
+    // the corner furthest along the normal is picked per plane, not per object
+    PlaneInput inputs[6];
+    for (int p=0; p<6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        inputs[p] = PlaneInput{
+            plane.x >= 0.0f ? bounds.maxX.data() : bounds.minX.data(),
+            plane.y >= 0.0f ? bounds.maxY.data() : bounds.minY.data(),
+            plane.z >= 0.0f ? bounds.maxZ.data() : bounds.minZ.data()
+        };
+    }
+    cullObjects(getRangeKernel<false>(kernel), inputs, nullptr, bounds.size(), frustum, visible, pool);
+}
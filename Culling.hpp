@@ -0,0 +1,55 @@
+#pragma once
+#include "config.hpp"
+#include "ThreadPool.hpp"
+
+// CPU frustum culling over structure-of-arrays bounds. The kernels test 4 (SSE) or 8 (AVX2)
+// objects against one plane per instruction and write the indices of the visible ones;
+// large object counts are split into chunks culled in parallel on a ThreadPool.
+
+// inward facing planes: a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+// Gribb-Hartmann extraction from proj*view*model, with Vulkan's clip space z in [0, w]
+Frustum getFrustum(const glm::mat4& clip);
+
+struct SphereBounds {
+    void resize(size_t count);
+    void set(size_t i, const float center[3], float sphereRadius);
+    size_t size() const { return centerX.size(); }
+
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+};
+struct BoxBounds {
+    void resize(size_t count);
+    void set(size_t i, const float min[3], const float max[3]);
+    size_t size() const { return minX.size(); }
+
+    std::vector<float> minX;
+    std::vector<float> minY;
+    std::vector<float> minZ;
+    std::vector<float> maxX;
+    std::vector<float> maxY;
+    std::vector<float> maxZ;
+};
+
+enum class CullKernel {
+    Scalar,
+    Sse,
+    Avx2
+};
+// widest kernel the CPU supports, detected once
+CullKernel getCullKernel();
+const char* getCullKernelName(CullKernel kernel);
+
+// below this many objects the work isn't worth waking the pool for
+constexpr size_t CULL_PARALLEL_MIN_OBJECTS = 32768;
+// visible receives the indices of the objects inside the frustum in ascending order
+void cullSpheres(const SphereBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, 
+    ThreadPool* pool = nullptr, CullKernel kernel = getCullKernel());
+// boxes are tested with their corner furthest along each plane normal, conservative like the spheres
+void cullBoxes(const BoxBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible, 
+    ThreadPool* pool = nullptr, CullKernel kernel = getCullKernel());
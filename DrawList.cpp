@@ -0,0 +1,88 @@
+#include "DrawList.hpp"
+
+uint64_t makeSortKey(DrawPass pass, uint32_t pipeline, uint32_t state, float depth) {
+    // the bits of a non-negative float order like the float, anything behind the eye sorts first
+    depth = std::max(depth, 0.0f);
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    return ((uint64_t)pass << 60) | ((uint64_t)(pipeline & 0xff) << 52) | ((uint64_t)(state & 0xfffff) << 32) | depthBits;
+}
+
+void DrawList::sort(ThreadPool* pool) {
+    sortPasses = 0;
+    size_t count = packets.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+    bool parallel = pool != nullptr && pool->getThreadCount() >= 2 && count >= DRAW_SORT_PARALLEL_MIN_PACKETS;
+    size_t chunkCount = parallel ? pool->getThreadCount()*4 : 1;
+    size_t chunkSize = (count + chunkCount - 1)/chunkCount;
+    chunkCount = (count + chunkSize - 1)/chunkSize;
+    // runs job(chunk, begin, end) over every chunk, on the pool when it is worth it
+    auto forChunks = [&](auto job) {
+        if (!parallel) {
+            job(0, 0, count);
+            return;
+        }
+        for (size_t chunk=0; chunk<chunkCount; chunk++) {
+            pool->submit([&job, chunk, chunkSize, count] {
+                job(chunk, chunk*chunkSize, std::min(chunk*chunkSize + chunkSize, count));
+            });
+        }
+        pool->wait();
+    };
+
+    // one read of the keys finds the digits that differ anywhere, the other passes would only copy
+    uint64_t firstKey = packets[0].key;
+    std::vector<uint64_t> chunkDiffs(chunkCount, 0);
+    forChunks([&](size_t chunk, size_t begin, size_t end) {
+        uint64_t diff = 0;
+        for (size_t i=begin; i<end; i++) {
+            diff |= packets[i].key ^ firstKey;
+        }
+        chunkDiffs[chunk] = diff;
+    });
+    uint64_t diff = 0;
+    for (uint64_t chunkDiff: chunkDiffs) {
+        diff |= chunkDiff;
+    }
+
+    // offsets[chunk*256 + digit]: the counts of each chunk, then where the chunk scatters that digit to
+    std::vector<uint32_t> offsets(chunkCount*256);
+    DrawPacket* src = packets.data();
+    DrawPacket* dst = scratch.data();
+    for (uint32_t shift=0; shift<64; shift+=8) {
+        if (((diff >> shift) & 0xff) == 0) {
+            continue;
+        }
+        forChunks([&](size_t chunk, size_t begin, size_t end) {
+            uint32_t* counts = &offsets[chunk*256];
+            std::fill(counts, counts + 256, 0);
+            for (size_t i=begin; i<end; i++) {
+                counts[(src[i].key >> shift) & 0xff]++;
+            }
+        });
+        // digit-major, chunk-minor prefix sum keeps equal digits in chunk order, which keeps the sort stable
+        uint32_t sum = 0;
+        for (uint32_t digit=0; digit<256; digit++) {
+            for (size_t chunk=0; chunk<chunkCount; chunk++) {
+                uint32_t digitCount = offsets[chunk*256 + digit];
+                offsets[chunk*256 + digit] = sum;
+                sum += digitCount;
+            }
+        }
+        forChunks([&](size_t chunk, size_t begin, size_t end) {
+            uint32_t* chunkOffsets = &offsets[chunk*256];
+            for (size_t i=begin; i<end; i++) {
+                dst[chunkOffsets[(src[i].key >> shift) & 0xff]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+        sortPasses++;
+    }
+    // an odd number of passes leaves the result in scratch
+    if (src != packets.data()) {
+        packets.swap(scratch);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "config.hpp"
+#include "ThreadPool.hpp"
+
+// Draw packets with 64 bit sort keys. The scene pushes one packet per draw, the list is radix
+// sorted and replayed in key order, so draws sharing state end up adjacent and the replay only
+// binds what differs from the previous packet.
+//
+// key, most significant first: pass (4 bits) | pipeline (8) | state (20) | depth (32)
+// state is whatever is bound between draws of one pipeline, depth sorts front to back.
+enum class DrawPass : uint32_t {
+    Opaque
+};
+uint64_t makeSortKey(DrawPass pass, uint32_t pipeline, uint32_t state, float depth);
+inline DrawPass getKeyPass(uint64_t key) { return (DrawPass)(key >> 60); }
+inline uint32_t getKeyPipeline(uint64_t key) { return (uint32_t)(key >> 52) & 0xff; }
+inline uint32_t getKeyState(uint64_t key) { return (uint32_t)(key >> 32) & 0xfffff; }
+
+// batches [first, first + count) of the engine's draw batches, more than one only for a multi-draw
+struct DrawPacket {
+    uint64_t key;
+    uint32_t first;
+    uint32_t count;
+};
+
+// below this many packets the sort runs on the calling thread
+constexpr size_t DRAW_SORT_PARALLEL_MIN_PACKETS = 16384;
+
+struct DrawList {
+    void clear() { packets.clear(); }
+    void push(uint64_t key, uint32_t first, uint32_t count = 1) { packets.push_back(DrawPacket{key, first, count}); }
+    // stable LSD radix sort on 8 bit digits, digits every key shares are skipped
+    void sort(ThreadPool* pool = nullptr);
+
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+    // digit passes the last sort actually ran, of 8
+    uint32_t sortPasses = 0;
+};
+
+// replay counters accumulated over frames; a bind is avoided when a packet needs state that the
+// previous packet already bound
+struct DrawStats {
+    uint64_t frames = 0;
+    uint64_t packets = 0;
+    uint64_t stateChanges = 0;
+    uint64_t stateChangesAvoided = 0;
+    double sortMs = 0.0;
+};
@@ -4,151 +4,396 @@
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        Engine* engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+        engine->setFramePacing(engine->framePacing == FramePacing::LowLatency ? 
+            FramePacing::Throughput : FramePacing::LowLatency);
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        Engine* engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+        engine->profiler.enabled = !engine->profiler.enabled;
+    }
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        Engine* engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+        engine->setMsaaSamples(engine->msaaSamples == VK_SAMPLE_COUNT_1_BIT ? 
+            engine->getMaxMsaaSamples(VK_SAMPLE_COUNT_4_BIT) : VK_SAMPLE_COUNT_1_BIT);
+    }
 }
 
-Engine::Engine() {
-    createWindow();
+Engine::Engine(EngineConfig engineConfig) : config(engineConfig) {
+    if (config.headless) {
+        instanceExtensions.clear();
+        deviceExtensions.clear();
+    } else {
+        createWindow();
+    }
+    if (!config.validation) {
+        instanceLayers.clear();
+    }
+    threadPool.start(std::thread::hardware_concurrency());
     createInstance();
-    createSurface();
+    if (!config.headless) {
+        createSurface();
+    }
     createDevice();
-    createSwapchain();
-    createMVP();
+    allocator.init(device, pDevice, ALLOCATOR_BLOCK_SIZE);
+    stagingRing.init(device, allocator, STAGING_RING_SIZE);
+    frameAllocator.init(device, pDevice, allocator, FRAME_ALLOCATOR_SLICE_SIZE, MAX_FRAMES_IN_FLIGHT);
+    createTimelineSemaphore(timeline, timelineValue);
+    createTimelineSemaphore(transferTimeline, transferTimelineValue);
     createCommandPool(gfxCmdPool, queueFamilyIndices.graphicsFamily.value());
-    createCommandPool(presentCmdPool, queueFamilyIndices.presentFamily.value());
     createCommandPool(transferCmdPool, queueFamilyIndices.transferFamily.value());
-    createColorAttachment();
-    createTextureImage();
-    createTextureSampler();
+    if (config.headless) {
+        createOffscreenTargets();
+    } else {
+        createSwapchain();
+    }
+    gfxCmdBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto& cmdBuffer: gfxCmdBuffers) {
+        cmdBuffer = allocateCommandBuffer(gfxCmdPool);
+    }
+    // value 0 is already reached, so the first MAX_FRAMES_IN_FLIGHT frames don't wait
+    frameTimelineValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    createMeshes();
+    buildRenderGraph();
+    profiler.init(device, pDevice, queueFamilyIndices.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+    gpuFrameMsaa.assign(MAX_FRAMES_IN_FLIGHT, false);
     createDescriptorSetLayout();
     createDescriptorPool();
     createDescriptorSets();
+    createTextureImage();
+    createMaterials();
     createGfxPipelineLayout();
     createGfxPipeline();
-    createVertexBuffer();
-    createIndexBuffer();
+    createCullPipeline();
+    createGeometryBuffers();
+    createObjects();
+    createIndirectBuffers();
+    flushUploads();
 }
 Engine::~Engine() {
-    vkDestroySampler(device, textureSampler, nullptr);
-    vkDestroyImage(device, textureImage, nullptr);
-    vkDestroyImageView(device, textureImageView, nullptr);
-    vkFreeMemory(device, textureImageMemory, nullptr);
-    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroyBuffer(device, MVPBuffers[i], nullptr);
-        vkFreeMemory(device, MVPBufferMemory[i], nullptr);
+    vkDeviceWaitIdle(device);
+    readbackWorker.stop();
+    threadPool.stop();
+    stagingRing.destroy(allocator);
+    frameAllocator.destroy(allocator);
+    destroyReadbackBuffers();
+    for (auto& [mipLevels, sampler]: textureSamplers) {
+        vkDestroySampler(device, sampler, nullptr);
+    }
+    for (auto& texture: textures) {
+        destroyTexture(texture);
     }
+    for (auto& [value, texture]: retiredTextures) {
+        destroyTexture(texture);
+    }
+    destroyTexture(fallbackTexture);
+    destroyIndirectBuffers();
+    vkDestroyBuffer(device, meshBuffer, nullptr);
+    allocator.free(meshBufferMemory);
+    vkDestroyBuffer(device, objectBuffer, nullptr);
+    allocator.free(objectBufferMemory);
     vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
+    allocator.free(indexBufferMemory);
     vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    allocator.free(vertexBufferMemory);
+    renderGraph.reset();
+    profiler.destroy();
+    vkDestroySemaphore(device, transferTimeline, nullptr);
+    vkDestroySemaphore(device, timeline, nullptr);
     vkDestroyCommandPool(device, transferCmdPool, nullptr);
-    vkDestroyCommandPool(device, presentCmdPool, nullptr);
     vkDestroyCommandPool(device, gfxCmdPool, nullptr);
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
     vkDestroyPipeline(device, gfxPipeline, nullptr);
     vkDestroyPipelineLayout(device, gfxPipelineLayout, nullptr);
     vkDestroyDescriptorPool(device, gfxDescriptorPool, nullptr);
-    vkDestroyDescriptorSetLayout(device, gfxDescriptorSetLayoutSampler, nullptr);
+    vkDestroyDescriptorSetLayout(device, gfxDescriptorSetLayoutTextures, nullptr);
     vkDestroyDescriptorSetLayout(device, gfxDescriptorSetLayoutUniform, nullptr);
     cleanupSwapchain();
+    allocator.destroy();
     vkDestroyDevice(device, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!config.headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
 
 void Engine::run() {
-    std::vector<VkCommandBuffer> gfxCmdBuffers(MAX_FRAMES_IN_FLIGHT);
-    for (auto& cmdBuffer: gfxCmdBuffers) {
-        cmdBuffer = allocateCommandBuffer(gfxCmdPool);
-    }
     std::vector<VkSemaphore> imageAvailable(MAX_FRAMES_IN_FLIGHT);
-    std::vector<VkSemaphore> renderingDone(MAX_FRAMES_IN_FLIGHT);
-    std::vector<VkFence> cmdBufferReady(MAX_FRAMES_IN_FLIGHT);
     for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
         createSemaphore(imageAvailable[i]);
-        createSemaphore(renderingDone[i]);
-        createFence(cmdBufferReady[i], VK_FENCE_CREATE_SIGNALED_BIT);
     }
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        
-        vkWaitForFences(device, 1, &cmdBufferReady[currFrame], VK_TRUE, ~0ull);
+        PROFILE_SCOPE(profiler, "frame");
+        {
+            PROFILE_SCOPE(profiler, "poll events");
+            glfwPollEvents();
+        }
+        {
+            PROFILE_SCOPE(profiler, "frame wait");
+            waitTimeline(frameTimelineValues[currFrame]);
+        }
+        collectFrameLatency();
+        collectGpuTime(currFrame);
+        dispatchReadbacks();
+        processUploads();
+        collectRetiredTextures();
         
         uint32_t imageIndex;
-        VkResult res = vkAcquireNextImageKHR(device, swapchain, ~0ull, imageAvailable[currFrame], VK_NULL_HANDLE, &imageIndex);
+        VkResult res;
+        {
+            PROFILE_SCOPE(profiler, "acquire");
+            res = vkAcquireNextImageKHR(device, swapchain, ~0ull, imageAvailable[currFrame], VK_NULL_HANDLE, &imageIndex);
+        }
         if (res==VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapchain();
             continue;
         } else if (res!=VK_SUBOPTIMAL_KHR && res!=VK_SUCCESS) {
             throw std::runtime_error("VK Error: cannot retrieve swapchain image");
         }
-        
-        vkResetFences(device, 1, &cmdBufferReady[currFrame]);
 
         vkResetCommandBuffer(gfxCmdBuffers[currFrame], 0);
 
-        updateMVP(currFrame);
-        recordCmdBuffer(gfxCmdBuffers[currFrame], imageIndex);
-
-        VkCommandBufferSubmitInfo cmdBufferSubmitInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-            .pNext = nullptr,
-            .commandBuffer = gfxCmdBuffers[currFrame],
-            .deviceMask = 0,
-        };
-        VkSemaphoreSubmitInfo imageAvailableSubmitInfo{
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-            .pNext = nullptr,
-            .semaphore = imageAvailable[currFrame],
-            .value = 0,
-            .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .deviceIndex = 0
-        };
-        VkSemaphoreSubmitInfo renderingDoneSubmitInfo{
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-            .pNext = nullptr,
-            .semaphore = renderingDone[currFrame],
-            .value = 0,
-            .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .deviceIndex = 0
-        };
-        VkSubmitInfo2 submitInfo{
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-            .pNext = nullptr,
-            .flags = 0,
-            .waitSemaphoreInfoCount = 1,
-            .pWaitSemaphoreInfos = &imageAvailableSubmitInfo,
-            .commandBufferInfoCount = 1,
-            .pCommandBufferInfos = &cmdBufferSubmitInfo,
-            .signalSemaphoreInfoCount = 1,
-            .pSignalSemaphoreInfos = &renderingDoneSubmitInfo
-        };
-        VK_CHECK(vkQueueSubmit2(gfxQueue, 1, &submitInfo, cmdBufferReady[currFrame]));
+        {
+            PROFILE_SCOPE(profiler, "updateMVP");
+            // the frame wait above guarantees the GPU is done with this slice
+            frameAllocator.beginFrame(currFrame);
+            updateMVP();
+        }
+        {
+            PROFILE_SCOPE(profiler, "recordCmdBuffer");
+            recordCmdBuffer(gfxCmdBuffers[currFrame], imageIndex);
+        }
+        {
+            PROFILE_SCOPE(profiler, "submit");
+            submitFrame(imageAvailable[currFrame], presentSemaphores[imageIndex]);
+        }
 
         VkPresentInfoKHR presentInfo{
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .pNext = nullptr,
             .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &renderingDone[currFrame],
+            .pWaitSemaphores = &presentSemaphores[imageIndex],
             .swapchainCount = 1,
             .pSwapchains = &swapchain,
             .pImageIndices = &imageIndex,
             .pResults = nullptr,
         };
-        res = vkQueuePresentKHR(presentQueue, &presentInfo);
+        {
+            PROFILE_SCOPE(profiler, "present");
+            res = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
         if (res==VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapchain();
         } else if (res!=VK_SUCCESS && res!=VK_SUBOPTIMAL_KHR) {
             throw std::runtime_error("VK Error: cannot present");
         }
+        // frames that finished while this one was recorded, so they aren't only seen at the next frame wait
+        collectFrameLatency();
         
-        currFrame=(currFrame+1)%MAX_FRAMES_IN_FLIGHT;
+        currFrame=(currFrame+1)%framesInFlight;
     }
     vkDeviceWaitIdle(device);
+    collectFrameLatency();
+    dispatchReadbacks();
+    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        collectGpuTime(i);
+    }
+    printFrameReport();
     for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device, imageAvailable[i], nullptr);
-        vkDestroySemaphore(device, renderingDone[i], nullptr);
-        vkDestroyFence(device, cmdBufferReady[i], nullptr);
+    }
+}
+void Engine::renderFrames(uint32_t frameCount) {
+    // headless: each frame in flight owns the offscreen target with the same index
+    // runs are compared frame by frame, so every asset has to be in place before the first one
+    waitUploads();
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame=0; frame<frameCount; frame++) {
+        renderFrame();
+    }
+    vkDeviceWaitIdle(device);
+    dispatchReadbacks();
+    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        collectGpuTime(i);
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+    collectFrameLatency();
+    std::cout << "Rendered " << frameCount << " frames in " << seconds << " s (" 
+        << frameCount/seconds << " fps)" << std::endl;
+    printFrameReport();
+}
+void Engine::renderFrame() {
+    PROFILE_SCOPE(profiler, "frame");
+    {
+        PROFILE_SCOPE(profiler, "frame wait");
+        waitTimeline(frameTimelineValues[currFrame]);
+    }
+    collectFrameLatency();
+    collectGpuTime(currFrame);
+    dispatchReadbacks();
+    processUploads();
+    collectRetiredTextures();
+
+    vkResetCommandBuffer(gfxCmdBuffers[currFrame], 0);
+
+    {
+        PROFILE_SCOPE(profiler, "updateMVP");
+        frameAllocator.beginFrame(currFrame);
+        updateMVP();
+    }
+    {
+        PROFILE_SCOPE(profiler, "recordCmdBuffer");
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        recordCmdBuffer(gfxCmdBuffers[currFrame], currFrame);
+        lastRecordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+    }
+    {
+        PROFILE_SCOPE(profiler, "submit");
+        submitFrame(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    }
+    collectFrameLatency();
+
+    currFrame=(currFrame+1)%framesInFlight;
+}
+void Engine::submitFrame(VkSemaphore waitSemaphore, VkSemaphore signalSemaphore) {
+    // get anything recorded this frame onto the transfer queue as early as possible
+    flushUploads();
+    VkCommandBufferSubmitInfo cmdBufferSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext = nullptr,
+        .commandBuffer = gfxCmdBuffers[currFrame],
+        .deviceMask = 0,
+    };
+    VkSemaphoreSubmitInfo waitSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = waitSemaphore,
+        .value = 0,
+        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .deviceIndex = 0
+    };
+    uint64_t frameValue = ++timelineValue;
+    std::vector<VkSemaphoreSubmitInfo> signalSubmitInfos = {
+        VkSemaphoreSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .semaphore = timeline,
+            .value = frameValue,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .deviceIndex = 0
+        }
+    };
+    if (signalSemaphore != VK_NULL_HANDLE) {
+        signalSubmitInfos.push_back(VkSemaphoreSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .semaphore = signalSemaphore,
+            .value = 0,
+            .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .deviceIndex = 0
+        });
+    }
+    VkSubmitInfo2 submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext = nullptr,
+        .flags = 0,
+        .waitSemaphoreInfoCount = waitSemaphore != VK_NULL_HANDLE ? 1u : 0u,
+        .pWaitSemaphoreInfos = &waitSubmitInfo,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &cmdBufferSubmitInfo,
+        .signalSemaphoreInfoCount = (uint32_t)signalSubmitInfos.size(),
+        .pSignalSemaphoreInfos = signalSubmitInfos.data()
+    };
+    VK_CHECK(vkQueueSubmit2(gfxQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    frameTimelineValues[currFrame] = frameValue;
+    frameNumber++;
+    pendingFrames.push_back(PendingFrame{
+        .timelineValue = frameValue,
+        .submitTime = std::chrono::high_resolution_clock::now(),
+        .pacing = framePacing
+    });
+}
+void Engine::setFramePacing(FramePacing pacing) {
+    framePacing = pacing;
+    setFramesInFlight(pacing == FramePacing::LowLatency ? LOW_LATENCY_FRAMES_IN_FLIGHT : MAX_FRAMES_IN_FLIGHT);
+}
+void Engine::setFramesInFlight(uint32_t count) {
+    // drain the old depth so no slot outside the new range is still in use
+    waitTimeline(timelineValue);
+    framesInFlight = std::clamp(count, 1u, MAX_FRAMES_IN_FLIGHT);
+    currFrame = 0;
+}
+void Engine::setMsaaSamples(VkSampleCountFlagBits samples) {
+    vkDeviceWaitIdle(device);
+    vkDestroyPipeline(device, gfxPipeline, nullptr);
+    msaaSamples = samples;
+    buildRenderGraph();
+    createGfxPipeline();
+}
+void Engine::enableReadback(ReadbackCallback consumer) {
+    if (!config.headless && !(getSurfaceDetails(pDevice).capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+        throw std::runtime_error("VK Error: swapchain images cannot be read back");
+    }
+    vkDeviceWaitIdle(device);
+    createReadbackBuffers();
+    readbackWorker.start(consumer, MAX_FRAMES_IN_FLIGHT);
+    readbackEnabled = true;
+    buildRenderGraph();
+}
+void Engine::createReadbackBuffers() {
+    // cached memory keeps the consumer's reads fast, coherent-only memory is the fallback
+    VkMemoryPropertyFlags memProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    if (!findMemoryTypeIndex(~0u, memProperties).has_value()) {
+        memProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+    VkDeviceSize size = (VkDeviceSize)swapchainExtent.width*swapchainExtent.height*4;
+    readbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    readbackBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    readbackFrameNumbers.assign(MAX_FRAMES_IN_FLIGHT, std::nullopt);
+    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(readbackBuffers[i], readbackBufferMemory[i], size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memProperties);
+    }
+}
+void Engine::destroyReadbackBuffers() {
+    for (uint32_t i=0; i<readbackBuffers.size(); i++) {
+        vkDestroyBuffer(device, readbackBuffers[i], nullptr);
+        allocator.free(readbackBufferMemory[i]);
+    }
+    readbackBuffers.clear();
+    readbackBufferMemory.clear();
+}
+void Engine::recordReadback(VkCommandBuffer& cmdBuffer) {
+    // the graph makes the copy visible to the host through the buffer's final HostRead usage
+    readbackWorker.waitSlotFree(currFrame);
+    copyImageToBuffer(cmdBuffer, renderGraph.images[graphTarget].image, readbackBuffers[currFrame],
+        swapchainExtent.width, swapchainExtent.height);
+    readbackFrameNumbers[currFrame] = frameNumber;
+}
+void Engine::dispatchReadbacks() {
+    // hand over every slot whose frame is done, not just the one about to be reused,
+    // so the consumer gets as much time as possible before the slot comes around again
+    if (!readbackEnabled) {
+        return;
+    }
+    uint64_t completed = getCompletedTimelineValue();
+    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        if (!readbackFrameNumbers[i].has_value() || frameTimelineValues[i] > completed) {
+            continue;
+        }
+        allocator.invalidate(readbackBufferMemory[i]);
+        readbackWorker.submit(i, ReadbackFrame{
+            .frameNumber = readbackFrameNumbers[i].value(),
+            .width = swapchainExtent.width,
+            .height = swapchainExtent.height,
+            .format = swapchainFormat,
+            .pixels = static_cast<const uint8_t*>(readbackBufferMemory[i].mapped)
+        });
+        readbackFrameNumbers[i].reset();
     }
 }
 void Engine::recordCmdBuffer(VkCommandBuffer& cmdBuffer, uint32_t imageIndex) {
@@ -159,86 +404,217 @@ void Engine::recordCmdBuffer(VkCommandBuffer& cmdBuffer, uint32_t imageIndex) {
         .pInheritanceInfo = nullptr
     };
     vkBeginCommandBuffer(cmdBuffer, &cmdBufferBegin);
+    profiler.beginGpuFrame(cmdBuffer, currFrame, Profiler::nowNs());
+    gpuFrameMsaa[currFrame] = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    renderGraph.setImportedImage(graphTarget, swapchainImages[imageIndex], swapchainImageViews[imageIndex]);
+    if (gpuCulling) {
+        renderGraph.setImportedBuffer(graphIndirect, indirectBuffers[currFrame]);
+    }
+    if (readbackEnabled) {
+        renderGraph.setImportedBuffer(graphReadback, readbackBuffers[currFrame]);
+    }
+    renderGraph.execute(cmdBuffer);
+    profiler.endGpuFrame(cmdBuffer, currFrame);
+    vkEndCommandBuffer(cmdBuffer);
+}
+void Engine::recordScene(VkCommandBuffer& cmdBuffer, VkImageView colorView, VkImageView resolveView) {
+    // without MSAA colorView is the target itself, otherwise it is resolved into resolveView
+    VkRenderingAttachmentInfo colorAttachmentInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext = nullptr,
+        .imageView = colorView,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .resolveImageView = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue{
+            .color{
+                {0.0f, 0.0f, 0.0f}
+            },
+        }
+    };
+    if (resolveView != VK_NULL_HANDLE) {
+        colorAttachmentInfo.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        colorAttachmentInfo.resolveImageView = resolveView;
+        colorAttachmentInfo.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+    VkRenderingInfo renderingInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .renderArea{
+            .offset{
+                .x = 0,
+                .y = 0,
+            },
+            .extent = swapchainExtent
+        },
+        .layerCount = 1,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachmentInfo,
+        .pDepthAttachment = nullptr,
+        .pStencilAttachment = nullptr
+    };
+    vkCmdBeginRendering(cmdBuffer, &renderingInfo);
     {
-        VkRenderingAttachmentInfo colorAttachmentInfo{
-            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-            .pNext = nullptr,
-            .imageView = colorImageView,
-            .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            .resolveMode = VK_RESOLVE_MODE_NONE,
-            .resolveImageView = VK_NULL_HANDLE,
-            .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .clearValue{
-                .color{
-                    {0.0f, 0.0f, 0.0f}
-                },
-            }
+        // the pipeline is bound by the first draw packet, everything else here holds for the whole pass
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 0, 1, &gfxDescriptorSet, 1, &mvpOffset);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 1, 1, &gfxDescriptorSetTextures, 
+            0, nullptr);
+
+        VkViewport viewport{
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = (float)swapchainExtent.width,
+            .height = (float)swapchainExtent.height,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
         };
-        VkRenderingInfo renderingInfo{
-            .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .renderArea{
-                .offset{
-                    .x = 0,
-                    .y = 0,
-                },
-                .extent = swapchainExtent
+        vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+        VkRect2D scissor{
+            .offset{
+                .x = 0,
+                .y = 0
             },
-            .layerCount = 1,
-            .viewMask = 0,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorAttachmentInfo,
-            .pDepthAttachment = nullptr,
-            .pStencilAttachment = nullptr
+            .extent = swapchainExtent
         };
-        vkCmdBeginRendering(cmdBuffer, &renderingInfo);
-        {
-            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline);
-            vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 0, 1, &gfxDescriptorSets[currFrame], 0, nullptr);
-            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipelineLayout, 1, 1, &gfxDescriptorSetSampler, 0, nullptr);
-
-            VkViewport viewport{
-                .x = 0.0f,
-                .y = 0.0f,
-                .width = (float)swapchainExtent.width,
-                .height = (float)swapchainExtent.height,
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f,
-            };
-            vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-            VkRect2D scissor{
-                .offset{
-                    .x = 0,
-                    .y = 0
-                },
-                .extent = swapchainExtent
-            };
-            vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+        vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-            vkCmdPushConstants(cmdBuffer, gfxPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
-            
-            vkCmdDrawIndexed(cmdBuffer, (uint32_t)indices.size(), 1, 0, 0, 0);
+        // draws whose data is still in flight on the transfer queue are skipped
+        if (isUploadReady(geometryTicket)) {
+            vkCmdPushConstants(cmdBuffer, gfxPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, 
+                sizeof(PushConstants), &pushConstants);
+            // packets come sorted by pipeline and index type, so a bind is only recorded when the
+            // packet's state differs from the one before; the pipeline layout is shared, so the
+            // descriptor sets and push constants stay valid across pipelines
+            VkPipeline pipelines[] = {gfxPipeline};
+            uint32_t boundPipeline = UINT32_MAX;
+            uint32_t boundIndexSize = 0;
+            uint64_t stateChanges = 0;
+            for (const DrawPacket& packet: drawList.packets) {
+                uint32_t pipeline = getKeyPipeline(packet.key);
+                if (pipeline != boundPipeline) {
+                    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipeline]);
+                    boundPipeline = pipeline;
+                    stateChanges++;
+                }
+                // both index types share the buffer, the state field of the key is the index size
+                uint32_t indexSize = getKeyState(packet.key);
+                if (indexSize != boundIndexSize) {
+                    vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+                    boundIndexSize = indexSize;
+                    stateChanges++;
+                }
+                if (gpuCulling) {
+                    // cull.comp filled in the instance counts, a packet is a run of batches sharing an index
+                    // type drawn by one multi-draw, so the CPU cost doesn't grow with the instance count
+                    vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffers[currFrame], 
+                        packet.first*sizeof(VkDrawIndexedIndirectCommand), packet.count, sizeof(VkDrawIndexedIndirectCommand));
+                } else {
+                    const DrawBatch& drawBatch = drawBatches[packet.first];
+                    const MeshRange& mesh = meshRanges[drawBatch.meshIndex];
+                    const MeshLod& lod = mesh.lods[drawBatch.lod];
+                    vkCmdDrawIndexed(cmdBuffer, lod.indexCount, visibleInstanceCounts[packet.first], lod.firstIndex, 
+                        mesh.vertexOffset, drawBatch.firstInstance);
+                }
+            }
+            // against binding the pipeline and the index buffer around every draw
+            drawStats.frames++;
+            drawStats.packets += drawList.packets.size();
+            drawStats.stateChanges += stateChanges;
+            drawStats.stateChangesAvoided += drawList.packets.size()*2 - stateChanges;
         }
-        vkCmdEndRendering(cmdBuffer);
-
-        transitionImageLayout(colorImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cmdBuffer);
-        transitionImageLayout(swapchainImages[imageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer);
-        copyImage(cmdBuffer, colorImage, swapchainImages[imageIndex], 
-            VkExtent3D{.width = swapchainExtent.width, .height = swapchainExtent.height, .depth = 1});
-        transitionImageLayout(swapchainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, cmdBuffer);
-        transitionImageLayout(colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, cmdBuffer);
     }
-    vkEndCommandBuffer(cmdBuffer);
+    vkCmdEndRendering(cmdBuffer);
+}
+void Engine::recordCull(VkCommandBuffer& cmdBuffer) {
+    // nothing is drawn until the tables are uploaded, so there is nothing to cull either
+    if (!isUploadReady(geometryTicket)) {
+        return;
+    }
+    CullPushConstants cullPushConstants{
+        .objectBufferAddress = pushConstants.objectBufferAddress,
+        .instanceBufferAddress = pushConstants.instanceBufferAddress,
+        .drawCommandAddress = indirectBufferAddresses[currFrame],
+        .visibleInstanceAddress = pushConstants.visibleInstanceAddress,
+        .cullDataAddress = cullDataAddress
+    };
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdPushConstants(cmdBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), 
+        &cullPushConstants);
+    vkCmdDispatch(cmdBuffer, ((uint32_t)objects.size() + 63)/64, 1, 1);
+}
+void Engine::buildRenderGraph() {
+    // rebuilt whenever the target extent, MSAA or readback change
+    renderGraph.reset();
+    graphTarget = renderGraph.importImage("target", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, config.headless ? ResourceUsage::TransferSrc : ResourceUsage::Present);
+    std::optional<uint32_t> msaaTarget;
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        msaaTarget = renderGraph.createImage("msaa color", RenderGraph::ImageDesc{
+            .format = swapchainFormat,
+            .extent = swapchainExtent,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            .samples = msaaSamples,
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
+        });
+    }
+    // passes record in the order they are added, so the commands are reset and culled before the
+    // scene draws them
+    if (gpuCulling) {
+        // the buffer is recycled with its frame slot, so nothing has to survive the frame
+        graphIndirect = renderGraph.importBuffer("indirect draws", std::nullopt);
+        uint32_t resetPass = renderGraph.addPass("reset draw commands", [this](VkCommandBuffer& cmdBuffer) {
+            if (isUploadReady(geometryTicket)) {
+                copyBuffer(cmdBuffer, drawCommandTemplate, 0, indirectBuffers[currFrame], 0, 
+                    drawBatches.size()*sizeof(VkDrawIndexedIndirectCommand));
+            }
+        });
+        renderGraph.useBuffer(resetPass, graphIndirect, ResourceUsage::TransferDst);
+        uint32_t cullPass = renderGraph.addPass("cull", [this](VkCommandBuffer& cmdBuffer) {
+            PROFILE_GPU_SCOPE(profiler, cmdBuffer, currFrame, "gpu: cull");
+            recordCull(cmdBuffer);
+        });
+        renderGraph.useBuffer(cullPass, graphIndirect, ResourceUsage::StorageWrite);
+    }
+    uint32_t scenePass = renderGraph.addPass("scene", [this, msaaTarget](VkCommandBuffer& cmdBuffer) {
+        PROFILE_GPU_SCOPE(profiler, cmdBuffer, currFrame, "gpu: render pass");
+        VkImageView targetView = renderGraph.getView(graphTarget);
+        if (msaaTarget.has_value()) {
+            recordScene(cmdBuffer, renderGraph.getView(msaaTarget.value()), targetView);
+        } else {
+            recordScene(cmdBuffer, targetView, VK_NULL_HANDLE);
+        }
+    });
+    renderGraph.useImage(scenePass, graphTarget, ResourceUsage::ColorAttachment);
+    if (msaaTarget.has_value()) {
+        renderGraph.useImage(scenePass, msaaTarget.value(), ResourceUsage::ColorAttachment);
+    }
+    if (gpuCulling) {
+        renderGraph.useBuffer(scenePass, graphIndirect, ResourceUsage::IndirectRead);
+        // render.vert reads the visible instance list behind the commands
+        renderGraph.useBuffer(scenePass, graphIndirect, ResourceUsage::StorageRead);
+    }
+    if (readbackEnabled) {
+        graphReadback = renderGraph.importBuffer("readback", ResourceUsage::HostRead);
+        uint32_t readbackPass = renderGraph.addPass("readback", [this](VkCommandBuffer& cmdBuffer) {
+            PROFILE_GPU_SCOPE(profiler, cmdBuffer, currFrame, "gpu: readback copy");
+            recordReadback(cmdBuffer);
+        }, true);
+        renderGraph.useImage(readbackPass, graphTarget, ResourceUsage::TransferSrc);
+        renderGraph.useBuffer(readbackPass, graphReadback, ResourceUsage::TransferDst);
+    }
+    renderGraph.compile(device, allocator);
 }
-
 void Engine::createWindow() {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan window", nullptr, nullptr);
+    window = glfwCreateWindow(config.width, config.height, "Vulkan window", nullptr, nullptr);
+    glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(window, key_callback);
 }
 void Engine::createInstance() {
@@ -274,10 +650,13 @@ void Engine::createDevice() {
     vkEnumeratePhysicalDevices(instance, &count, nullptr);
     std::vector<VkPhysicalDevice> devices(count);
     vkEnumeratePhysicalDevices(instance, &count, devices.data());
+    pDevice = VK_NULL_HANDLE;
+    int bestScore = -1;
     for (const auto& dev: devices) {
-        if (isDeviceSuitable(dev)) {
+        int score = getDeviceScore(dev);
+        if (score > bestScore && isDeviceSuitable(dev)) {
             pDevice = dev;
-            break;
+            bestScore = score;
         }
     }
     if (pDevice==VK_NULL_HANDLE) {
@@ -287,9 +666,11 @@ void Engine::createDevice() {
 
     std::set<uint32_t> uniqueQueueFamilyIndices = {
         queueFamilyIndices.graphicsFamily.value(),
-        queueFamilyIndices.transferFamily.value(),
-        queueFamilyIndices.presentFamily.value() 
+        queueFamilyIndices.transferFamily.value()
     };
+    if (queueFamilyIndices.presentFamily.has_value()) {
+        uniqueQueueFamilyIndices.insert(queueFamilyIndices.presentFamily.value());
+    }
     std::vector<VkDeviceQueueCreateInfo> queueCIs;
     float priority = 1.0f;
     for (uint32_t queueFamilyIndex: uniqueQueueFamilyIndices) {
@@ -304,12 +685,32 @@ void Engine::createDevice() {
         queueCIs.push_back(queueCI);
     }
 
+    VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supportedFeatures12;
+    vkGetPhysicalDeviceFeatures2(pDevice, &supportedFeatures2);
+    const VkPhysicalDeviceFeatures& supportedFeatures = supportedFeatures2.features;
+    gpuCulling = config.gpuCulling && supportedFeatures.drawIndirectFirstInstance;
     VkPhysicalDeviceFeatures features{};
     features.multiDrawIndirect = VK_TRUE;
-    features.samplerAnisotropy = VK_TRUE;
+    features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    features.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+    // block compressed textures, supportsTextureFormat reports which formats can be sampled
+    features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    features.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
     VkPhysicalDeviceVulkan12Features features12{};
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.bufferDeviceAddress = VK_TRUE;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.scalarBlockLayout = supportedFeatures12.scalarBlockLayout;
+    // the bindless texture array, checked by isDeviceSuitable
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
     VkPhysicalDeviceVulkan13Features features13{};
     features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
     features13.pNext = &features12;
@@ -329,7 +730,9 @@ void Engine::createDevice() {
     };
     VK_CHECK(vkCreateDevice(pDevice, &deviceCI, nullptr, &device));
     vkGetDeviceQueue(device, queueFamilyIndices.graphicsFamily.value(), 0, &gfxQueue);
-    vkGetDeviceQueue(device, queueFamilyIndices.presentFamily.value(), 0, &presentQueue);
+    if (queueFamilyIndices.presentFamily.has_value()) {
+        vkGetDeviceQueue(device, queueFamilyIndices.presentFamily.value(), 0, &presentQueue);
+    }
     vkGetDeviceQueue(device, queueFamilyIndices.transferFamily.value(), 0, &transferQueue);
 }
 void Engine::createSwapchain() {
@@ -352,7 +755,8 @@ void Engine::createSwapchain() {
         .imageColorSpace = surfaceFormat.colorSpace,
         .imageExtent = swapchainExtent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | 
+            (surfaceDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
         .pQueueFamilyIndices = nullptr,
@@ -367,8 +771,8 @@ void Engine::createSwapchain() {
         queueFamilyIndices.transferFamily.value(),
         queueFamilyIndices.presentFamily.value() 
     };
+    std::vector<uint32_t> queueFamilies(uniqueQueueFamilyIndices.begin(), uniqueQueueFamilyIndices.end());
     if (uniqueQueueFamilyIndices.size() > 1) {
-        std::vector<uint32_t> queueFamilies(uniqueQueueFamilyIndices.begin(), uniqueQueueFamilyIndices.end());
         swapchainCI.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
         swapchainCI.queueFamilyIndexCount = (uint32_t)uniqueQueueFamilyIndices.size();
         swapchainCI.pQueueFamilyIndices = queueFamilies.data();
@@ -378,26 +782,61 @@ void Engine::createSwapchain() {
     swapchainImages.resize(imageCount);
     swapchainImageViews.resize(imageCount);
     vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data());
+    presentSemaphores.resize(imageCount);
     for (uint32_t i=0; i<imageCount; i++) {
         createImageView(swapchainImages[i], swapchainImageViews[i], VK_IMAGE_ASPECT_COLOR_BIT, swapchainFormat);
+        createSemaphore(presentSemaphores[i]);
     }
 }
 void Engine::recreateSwapchain() {
     vkDeviceWaitIdle(device);
+    if (readbackEnabled) {
+        // the ring is sized for the old extent, flush it before resizing
+        dispatchReadbacks();
+        for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+            readbackWorker.waitSlotFree(i);
+        }
+        destroyReadbackBuffers();
+    }
     cleanupSwapchain();
-    createColorAttachment();
     createSwapchain();
+    buildRenderGraph();
+    if (readbackEnabled) {
+        createReadbackBuffers();
+    }
+}
+void Engine::createOffscreenTargets() {
+    // stands in for the swapchain when there is no surface, one target per frame in flight
+    swapchainExtent = VkExtent2D{.width = config.width, .height = config.height};
+    swapchainFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    swapchainImages.resize(MAX_FRAMES_IN_FLIGHT);
+    swapchainImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+    offscreenImageMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        createImage(swapchainImages[i], offscreenImageMemory[i], swapchainFormat, 
+            VkExtent3D{.width = swapchainExtent.width, .height = swapchainExtent.height, .depth = 1},
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT);
+        createImageView(swapchainImages[i], swapchainImageViews[i], VK_IMAGE_ASPECT_COLOR_BIT, swapchainFormat);
+    }
 }
 void Engine::cleanupSwapchain() {
-    vkDestroyImage(device, colorImage, nullptr);
-    vkDestroyImageView(device, colorImageView, nullptr);
-    vkFreeMemory(device, colorImageMemory, nullptr);
     for (auto& imageView: swapchainImageViews) {
         vkDestroyImageView(device, imageView, nullptr);
     }
+    for (auto& sem: presentSemaphores) {
+        vkDestroySemaphore(device, sem, nullptr);
+    }
+    if (config.headless) {
+        for (uint32_t i=0; i<swapchainImages.size(); i++) {
+            vkDestroyImage(device, swapchainImages[i], nullptr);
+            allocator.free(offscreenImageMemory[i]);
+        }
+        return;
+    }
     vkDestroySwapchainKHR(device, swapchain, nullptr);
 }
-void Engine::createImageView(VkImage& image, VkImageView& imageView, VkImageAspectFlags aspectMask, VkFormat format) {
+void Engine::createImageView(VkImage& image, VkImageView& imageView, VkImageAspectFlags aspectMask, VkFormat format, 
+    uint32_t mipLevels) {
     VkImageViewCreateInfo imageViewCI{
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .pNext = nullptr,
@@ -414,7 +853,7 @@ void Engine::createImageView(VkImage& image, VkImageView& imageView, VkImageAspe
         .subresourceRange{
             .aspectMask = aspectMask,
             .baseMipLevel = 0,
-            .levelCount = 1,
+            .levelCount = mipLevels,
             .baseArrayLayer = 0,
             .layerCount = 1
         },
@@ -424,18 +863,11 @@ void Engine::createImageView(VkImage& image, VkImageView& imageView, VkImageAspe
 void Engine::createDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding descriptorSetLayoutBindingUniform{
         .binding = 0,
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
         .descriptorCount = 1,
         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
         .pImmutableSamplers = nullptr
     };
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBindingSampler{
-        .binding = 0,
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = 1,
-        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .pImmutableSamplers = nullptr
-    };
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .pNext = nullptr,
@@ -444,92 +876,100 @@ void Engine::createDescriptorSetLayout() {
         .pBindings = &descriptorSetLayoutBindingUniform
     };
     VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &gfxDescriptorSetLayoutUniform));
-    descriptorSetLayoutCI.pBindings = &descriptorSetLayoutBindingSampler;
-    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &gfxDescriptorSetLayoutSampler));
+
+    // a combined image sampler counts against both the sampler and the sampled image limits
+    VkPhysicalDeviceVulkan12Properties props12{};
+    props12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 props2{};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &props12;
+    vkGetPhysicalDeviceProperties2(pDevice, &props2);
+    textureSlots.init(std::min({MAX_TEXTURE_SLOTS, props12.maxPerStageDescriptorUpdateAfterBindSamplers, 
+        props12.maxPerStageDescriptorUpdateAfterBindSampledImages, props12.maxDescriptorSetUpdateAfterBindSamplers,
+        props12.maxDescriptorSetUpdateAfterBindSampledImages}));
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindingTextures{
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = textureSlots.capacity,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = nullptr
+    };
+    // slots are written while frames sampling other slots are in flight, and most are never written at all
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | 
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext = nullptr,
+        .bindingCount = 1,
+        .pBindingFlags = &bindingFlags
+    };
+    descriptorSetLayoutCI.pNext = &bindingFlagsCI;
+    descriptorSetLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    descriptorSetLayoutCI.pBindings = &descriptorSetLayoutBindingTextures;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &gfxDescriptorSetLayoutTextures));
 }
 void Engine::createDescriptorPool() {
     VkDescriptorPoolSize poolSizeUniform{
-        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptorCount = MAX_FRAMES_IN_FLIGHT
+        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .descriptorCount = 1
     };
-    VkDescriptorPoolSize poolSizeSampler{
+    VkDescriptorPoolSize poolSizeTextures{
         .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = 1
+        .descriptorCount = textureSlots.capacity
     };
-    std::vector<VkDescriptorPoolSize> poolSizes = {poolSizeUniform, poolSizeSampler};
+    std::vector<VkDescriptorPoolSize> poolSizes = {poolSizeUniform, poolSizeTextures};
     VkDescriptorPoolCreateInfo descriptorPoolCI{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = nullptr,
-        .flags = 0,
-        .maxSets = MAX_FRAMES_IN_FLIGHT+1,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 2,
         .poolSizeCount = (uint32_t)poolSizes.size(),
         .pPoolSizes = poolSizes.data()
     };
     VK_CHECK(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &gfxDescriptorPool));
 }
 void Engine::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, gfxDescriptorSetLayoutUniform);
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
         .pNext = nullptr,
         .descriptorPool = gfxDescriptorPool,
-        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
-        .pSetLayouts = layouts.data()
+        .descriptorSetCount = 1,
+        .pSetLayouts = &gfxDescriptorSetLayoutUniform
     };
-    gfxDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, gfxDescriptorSets.data()));
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &gfxDescriptorSet));
 
-    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorBufferInfo descriptorBufferInfo{
-            .buffer = MVPBuffers[i],
-            .offset = 0,
-            .range = sizeof(MVP)
-        };
-        VkWriteDescriptorSet writeDescriptroSet{
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext = nullptr,
-            .dstSet = gfxDescriptorSets[i],
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pImageInfo = nullptr,
-            .pBufferInfo = &descriptorBufferInfo,
-            .pTexelBufferView = nullptr,
-        };
-        vkUpdateDescriptorSets(device, 1, &writeDescriptroSet, 0, nullptr);
-    }
-
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &gfxDescriptorSetLayoutSampler;
-    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &gfxDescriptorSetSampler));
-    VkDescriptorImageInfo descriptorImageInfo{
-        .sampler = textureSampler,
-        .imageView = textureImageView,
-        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    // written once, every frame only passes the dynamic offset of its MVP
+    VkDescriptorBufferInfo descriptorBufferInfo{
+        .buffer = frameAllocator.buffer,
+        .offset = 0,
+        .range = sizeof(MVP)
     };
-    VkWriteDescriptorSet writeDescriptroSet{
+    VkWriteDescriptorSet writeDescriptorSetUniform{
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .pNext = nullptr,
-        .dstSet = gfxDescriptorSetSampler,
+        .dstSet = gfxDescriptorSet,
         .dstBinding = 0,
         .dstArrayElement = 0,
         .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .pImageInfo = &descriptorImageInfo,
-        .pBufferInfo = nullptr,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .pImageInfo = nullptr,
+        .pBufferInfo = &descriptorBufferInfo,
         .pTexelBufferView = nullptr,
     };
-    vkUpdateDescriptorSets(device, 1, &writeDescriptroSet, 0, nullptr);
+    vkUpdateDescriptorSets(device, 1, &writeDescriptorSetUniform, 0, nullptr);
+
+    // the slots are written by createTexture as textures load
+    descriptorSetAllocateInfo.pSetLayouts = &gfxDescriptorSetLayoutTextures;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &gfxDescriptorSetTextures));
 }
 void Engine::createGfxPipelineLayout() {
     VkPushConstantRange pushConstantRange{
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         .offset = 0,
         .size = sizeof(PushConstants)
     };
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {gfxDescriptorSetLayoutUniform, gfxDescriptorSetLayoutSampler};
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {gfxDescriptorSetLayoutUniform, gfxDescriptorSetLayoutTextures};
     VkPipelineLayoutCreateInfo pipelineLayoutCI{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = nullptr,
@@ -631,7 +1071,7 @@ void Engine::createGfxPipeline() {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .rasterizationSamples = msaaSamples,
         .sampleShadingEnable = VK_FALSE,
         .minSampleShading = 0.0f,
         .pSampleMask = nullptr,
@@ -739,6 +1179,50 @@ void Engine::createGfxPipeline() {
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
+void Engine::createCullPipeline() {
+    if (!gpuCulling) {
+        return;
+    }
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(CullPushConstants)
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutCI{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .setLayoutCount = 0,
+        .pSetLayouts = nullptr,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &cullPipelineLayout));
+
+    std::vector<char> compCode = readFile("../cull.comp.spv");
+    VkShaderModule compShaderModule;
+    createShaderModule(compCode, compShaderModule);
+    VkComputePipelineCreateInfo cullPipelineCI{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stage{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = compShaderModule,
+            .pName = "main",
+            .pSpecializationInfo = nullptr
+        },
+        .layout = cullPipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &cullPipelineCI, nullptr, &cullPipeline));
+
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
 void Engine::createShaderModule(std::vector<char> code, VkShaderModule& shaderModule) {
     VkShaderModuleCreateInfo shaderModuleCI{
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -768,15 +1252,21 @@ void Engine::createSemaphore(VkSemaphore& sem) {
     };
     VK_CHECK(vkCreateSemaphore(device, &semCI, nullptr, &sem));
 }
-void Engine::createFence(VkFence& fence, VkFenceCreateFlags flags) {
-    VkFenceCreateInfo fenceCI{
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+void Engine::createTimelineSemaphore(VkSemaphore& sem, uint64_t initialValue) {
+    VkSemaphoreTypeCreateInfo semTypeCI{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
         .pNext = nullptr,
-        .flags = flags
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initialValue
+    };
+    VkSemaphoreCreateInfo semCI{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semTypeCI,
+        .flags = 0,
     };
-    VK_CHECK(vkCreateFence(device, &fenceCI, nullptr, &fence));
+    VK_CHECK(vkCreateSemaphore(device, &semCI, nullptr, &sem));
 }
-void Engine::createBuffer(VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage,
+void Engine::createBuffer(VkBuffer& buffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage,
     VkMemoryPropertyFlags memProperties) {
     VkBufferCreateInfo bufferCI{
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -789,124 +1279,451 @@ void Engine::createBuffer(VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkDevi
         .pQueueFamilyIndices = nullptr
     };
     VK_CHECK(vkCreateBuffer(device, &bufferCI, nullptr, &buffer));
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateFlagsInfo allocateFlagsInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
-        .pNext = nullptr,
-        .flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR,
-        .deviceMask = 0
-    };
-    VkMemoryAllocateInfo allocateInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = &allocateFlagsInfo,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = getMemoryTypeIndex(memRequirements.memoryTypeBits, memProperties)
-    };
-    VK_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &bufferMemory));  
-
-    VK_CHECK(vkBindBufferMemory(device, buffer, bufferMemory, 0));
+    bufferMemory = allocator.allocateBuffer(buffer, memProperties);
+}
+void Engine::createGeometryBuffers() {
+    if (!meshPack.isOpen()) {
+        createVertexBuffer(vertexData.data(), vertexData.size());
+        createIndexBuffer(indexData.data(), indexData.size());
+        return;
+    }
+    // staged straight from the mapping: the file is read by the page faults of the staging memcpy
+    // and never lands in an intermediate vector
+    auto startTime = std::chrono::high_resolution_clock::now();
+    createVertexBuffer(meshPack.vertexData, meshPack.header->vertexBytes);
+    createIndexBuffer(meshPack.indexData, meshPack.header->indexBytes);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+    double megabytes = (meshPack.header->vertexBytes + meshPack.header->indexBytes)/(1024.0*1024.0);
+    std::cout << "Staged " << meshRanges.size() << " meshes (" << megabytes << " MiB) from " << config.meshPackPath 
+        << " in " << seconds*1000.0 << " ms: " << megabytes/seconds << " MiB/s" << std::endl;
+    meshPack.close();
 }
-void Engine::createVertexBuffer() {
-    vertexBufferSize = sizeof(vertices[0])*vertices.size();
+void Engine::createVertexBuffer(const void* data, VkDeviceSize size) {
+    vertexBufferSize = size;
     createBuffer(vertexBuffer, vertexBufferMemory, vertexBufferSize, 
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | 
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(stagingBuffer, stagingBufferMemory, vertexBufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    geometryTicket = uploadBuffer(vertexBuffer, 0, data, vertexBufferSize);
     
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, vertexBufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)vertexBufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    VkCommandBuffer cmdBuffer = beginSingleCommandRecording(transferCmdPool);
-    copyBuffer(cmdBuffer, stagingBuffer, vertexBuffer, vertexBufferSize);
-    endSingleCommandRecording(cmdBuffer, transferQueue);
-    
-    VkBufferDeviceAddressInfo bdaInfo{
-        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-        .pNext = nullptr,
-        .buffer = vertexBuffer
-    };
-    vertexBufferAddress = vkGetBufferDeviceAddress(device, &bdaInfo);
-    
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-
+    vertexBufferAddress = getBufferAddress(vertexBuffer);
     pushConstants.vertexBufferAddress = vertexBufferAddress;
 }
-void Engine::createIndexBuffer() {
-    indexBufferSize = sizeof(indices[0])*indices.size();
+void Engine::createIndexBuffer(const void* data, VkDeviceSize size) {
+    indexBufferSize = size;
     createBuffer(indexBuffer, indexBufferMemory, indexBufferSize, 
         VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(stagingBuffer, stagingBufferMemory, indexBufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, indexBufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)indexBufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
 
-    VkCommandBuffer cmdBuffer = beginSingleCommandRecording(transferCmdPool);
-    copyBuffer(cmdBuffer, stagingBuffer, indexBuffer, indexBufferSize);
-    endSingleCommandRecording(cmdBuffer, transferQueue);
-    
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-void Engine::createMVP() {
-    MVPBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    MVPBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    MVPBufferMemoryMapped.resize(MAX_FRAMES_IN_FLIGHT);
-    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
-        createBuffer(MVPBuffers[i], MVPBufferMemory[i], sizeof(MVP), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        vkMapMemory(device, MVPBufferMemory[i], 0, sizeof(MVP), 0, &MVPBufferMemoryMapped[i]);
-    }
+    UploadTicket indexTicket = uploadBuffer(indexBuffer, 0, data, indexBufferSize);
+    geometryTicket.transferValue = std::max(geometryTicket.transferValue, indexTicket.transferValue);
 }
 void Engine::createTextureImage() {
+    uint32_t white = 0xffffffff;
+    createTexture(fallbackTexture, &white, 1, 1);
+    if (!config.texturePaths.empty()) {
+        for (const std::string& path: config.texturePaths) {
+            loadTexture(path);
+        }
+        return;
+    }
+    if (config.syntheticScene.has_value()) {
+        // checkerboards with a different tint per texture so every material is visible
+        uint32_t size = config.syntheticScene->textureSize;
+        std::vector<uint32_t> pixels(size*size);
+        for (uint32_t t=0; t<config.syntheticScene->textureCount; t++) {
+            uint32_t tint = 0xff000000 | ((t*0x9e3779b9u) & 0x00ffffff);
+            for (uint32_t y=0; y<size; y++) {
+                for (uint32_t x=0; x<size; x++) {
+                    pixels[y*size+x] = ((x/16 + y/16)%2) ? tint : 0xffffffff;
+                }
+            }
+            loadTexture(pixels.data(), size, size);
+        }
+        return;
+    }
     int texWidth;
     int texHeight;
     int texChannels;
     stbi_uc* pixels = stbi_load("../texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize textureSize = texWidth*texHeight*4;
-    createImage(textureImage, textureImageMemory, VK_FORMAT_R8G8B8A8_UNORM, 
-        VkExtent3D{.width=(uint32_t)texWidth, .height=(uint32_t)texHeight, .depth=1}, 
-        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-    createImageView(textureImage, textureImageView, VK_IMAGE_ASPECT_COLOR_BIT, VK_FORMAT_R8G8B8A8_UNORM);
-    
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(stagingBuffer, stagingBufferMemory, textureSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, textureSize, 0, &data);
-    memcpy(data, pixels, (size_t)textureSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    VkCommandBuffer cmdBuffer = beginSingleCommandRecording(gfxCmdPool);
-    transitionImageLayout(textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer);
-    copyBufferToImage(cmdBuffer, stagingBuffer, textureImage, texWidth, texHeight);
-    transitionImageLayout(textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer);
-    endSingleCommandRecording(cmdBuffer, gfxQueue);
-    
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    loadTexture(pixels, (uint32_t)texWidth, (uint32_t)texHeight);
     stbi_image_free(pixels);
 }
-void Engine::createTextureSampler() {
+void Engine::createTexture(Texture& texture, const void* pixels, uint32_t width, uint32_t height) {
+    TextureLevel level{
+        .width = width,
+        .height = height,
+        .data = static_cast<const uint8_t*>(pixels),
+        .size = (VkDeviceSize)width*height*4
+    };
+    createTexture(texture, VK_FORMAT_R8G8B8A8_UNORM, {level}, true);
+}
+void Engine::createTexture(Texture& texture, VkFormat format, const std::vector<TextureLevel>& levels, bool generateMips) {
+    TextureFormatInfo info = getTextureFormatInfo(format).value();
+    uint32_t width = levels[0].width;
+    uint32_t height = levels[0].height;
+    // block compressed chains come prebuilt, a file without one is sampled at level 0 only
+    bool fillLevels = generateMips && config.mipmaps && levels.size() == 1 && info.blockWidth == 1;
+    texture.mipLevels = fillLevels ? getMipLevelCount(width, height) : (uint32_t)levels.size();
+    // the blits read the level above the one they write
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | 
+        (fillLevels ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+    createImage(texture.image, texture.memory, format, 
+        VkExtent3D{.width=width, .height=height, .depth=1}, usage, VK_SAMPLE_COUNT_1_BIT, texture.mipLevels);
+    createImageView(texture.image, texture.view, VK_IMAGE_ASPECT_COLOR_BIT, format, texture.mipLevels);
+    texture.ticket = uploadImage(texture.image, format, levels, texture.mipLevels);
+    textureStats.textures++;
+    textureStats.bytes += texture.memory.size;
+    for (uint32_t level=0; level<texture.mipLevels; level++) {
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+        if (level > 0) {
+            textureStats.mipBytes += getTextureLevelSize(info, levelWidth, levelHeight);
+        }
+        textureStats.rgba8Bytes += (uint64_t)levelWidth*levelHeight*4;
+    }
+
+    // the slot is unused by every frame in flight, so it is written right away; materials only
+    // point at it once the upload is ready
+    texture.slot = textureSlots.allocate();
+    VkDescriptorImageInfo descriptorImageInfo{
+        .sampler = getTextureSampler(texture.mipLevels),
+        .imageView = texture.view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet writeDescriptorSet{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = gfxDescriptorSetTextures,
+        .dstBinding = 0,
+        .dstArrayElement = texture.slot,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &descriptorImageInfo,
+        .pBufferInfo = nullptr,
+        .pTexelBufferView = nullptr,
+    };
+    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+}
+void Engine::destroyTexture(Texture& texture) {
+    if (texture.image == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyImageView(device, texture.view, nullptr);
+    vkDestroyImage(device, texture.image, nullptr);
+    allocator.free(texture.memory);
+    texture = Texture{};
+}
+uint32_t Engine::loadTexture(const void* pixels, uint32_t width, uint32_t height) {
+    textures.emplace_back();
+    createTexture(textures.back(), pixels, width, height);
+    return (uint32_t)textures.size()-1;
+}
+uint32_t Engine::loadTexture(const std::string& path) {
+    Ktx2File file;
+    file.open(path);
+    if (file.supercompression != KTX2_SUPERCOMPRESSION_NONE) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        try {
+            file.inflate(&threadPool);
+        } catch (...) {
+            file.close();
+            throw;
+        }
+        textureStats.inflateMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        textureStats.supercompressedTextures++;
+    }
+    textures.emplace_back();
+    if (supportsTextureFormat(file.format)) {
+        // the levels are staged straight from the mapping, or from the inflated levels
+        createTexture(textures.back(), file.format, file.levels, file.generateMips);
+        if (getTextureFormatInfo(file.format)->blockWidth > 1) {
+            textureStats.compressedTextures++;
+        }
+    } else if (canDecodeToRgba8(file.format) && supportsTextureFormat(getDecodedFormat(file.format))) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<std::vector<uint8_t>> pixels(file.levels.size());
+        std::vector<TextureLevel> levels;
+        for (size_t i=0; i<file.levels.size(); i++) {
+            const TextureLevel& level = file.levels[i];
+            pixels[i].resize((size_t)level.width*level.height*4);
+            decodeToRgba8(file.format, level, pixels[i].data(), &threadPool);
+            levels.push_back(TextureLevel{.width = level.width, .height = level.height, .data = pixels[i].data(), 
+                .size = pixels[i].size()});
+        }
+        textureStats.decodeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        textureStats.decodedTextures++;
+        createTexture(textures.back(), getDecodedFormat(file.format), levels, file.generateMips);
+    } else {
+        textures.pop_back();
+        file.close();
+        throw std::runtime_error(std::string("VK Error: device can't sample ") + string_VkFormat(file.format) + ", " + path);
+    }
+    file.close();
+    return (uint32_t)textures.size()-1;
+}
+void Engine::unloadTexture(uint32_t textureIndex) {
+    Texture& texture = textures[textureIndex];
+    if (texture.image == VK_NULL_HANDLE) {
+        return;
+    }
+    // the copy into the image must finish before the image can go away
+    if (!isUploadReady(texture.ticket)) {
+        waitUploads();
+    }
+    // every frame submitted so far may have sampled it, and so may the frame being recorded when
+    // its material table was already built; the one after that will not
+    textureSlots.retire(texture.slot, timelineValue+1);
+    retiredTextures.emplace_back(timelineValue+1, texture);
+    texture = Texture{};
+}
+void Engine::collectRetiredTextures() {
+    uint64_t completed = getCompletedTimelineValue();
+    textureSlots.collect(completed);
+    while (!retiredTextures.empty() && retiredTextures.front().first <= completed) {
+        destroyTexture(retiredTextures.front().second);
+        retiredTextures.pop_front();
+    }
+}
+void Engine::createMaterials() {
+    for (uint32_t i=0; i<textures.size(); i++) {
+        materials.push_back(Material{.baseColor = glm::vec4(1.0f), .textureIndex = i});
+    }
+}
+void Engine::updateMaterials() {
+    FrameAllocation allocation = frameAllocator.allocate(materials.size()*sizeof(GpuMaterial));
+    GpuMaterial* gpuMaterials = (GpuMaterial*)allocation.data;
+    for (size_t i=0; i<materials.size(); i++) {
+        const Texture& texture = textures[materials[i].textureIndex];
+        bool ready = texture.image != VK_NULL_HANDLE && isUploadReady(texture.ticket);
+        memcpy(gpuMaterials[i].baseColor, &materials[i].baseColor, sizeof(gpuMaterials[i].baseColor));
+        gpuMaterials[i].textureSlot = ready ? texture.slot : fallbackTexture.slot;
+    }
+    pushConstants.materialBufferAddress = allocation.address;
+}
+void Engine::createMeshes() {
+    if (!config.meshPackPath.empty()) {
+        meshPack.open(config.meshPackPath);
+        // MeshPack::open already rejected entries without levels
+        meshRanges.assign(meshPack.meshes, meshPack.meshes + meshPack.header->meshCount);
+        if (meshRanges.empty()) {
+            throw std::runtime_error("VK Error: no triangles to draw");
+        }
+        return;
+    }
+    std::vector<Mesh> meshes;
+    if (!config.meshPaths.empty()) {
+        meshes = loadMeshes(config.meshPaths, threadPool, meshLoadStats);
+        double megabytes = meshLoadStats.bytes/(1024.0*1024.0);
+        std::cout << "Loaded " << meshLoadStats.fileCount << " meshes (" << megabytes << " MiB, " 
+            << meshLoadStats.triangles << " triangles) in " << meshLoadStats.seconds*1000.0 << " ms on " 
+            << threadPool.getThreadCount() << " threads: " << megabytes/meshLoadStats.seconds << " MiB/s, " 
+            << meshLoadStats.triangles/meshLoadStats.seconds/1e6 << " Mtri/s, " << meshLoadStats.uniqueVertices 
+            << " unique of " << meshLoadStats.inputVertices << " vertices" << std::endl;
+        double triangles = (double)std::max<uint64_t>(meshLoadStats.triangles, 1);
+        std::cout << "Optimized meshes: ACMR " << meshLoadStats.cacheMissesBefore/triangles << " -> " 
+            << meshLoadStats.cacheMissesAfter/triangles << ", " << meshLoadStats.lodTriangles 
+            << " triangles in levels of detail" << std::endl;
+    } else if (config.syntheticScene.has_value()) {
+        meshes.push_back(createSyntheticMesh());
+        buildLods(meshes.back(), meshLoadStats);
+    } else {
+        meshes.push_back(createQuadMesh());
+    }
+    packMeshes(meshes);
+    uint64_t indexCount = 0;
+    for (auto& mesh: meshRanges) {
+        for (uint32_t lod=0; lod<mesh.lodCount; lod++) {
+            indexCount += mesh.lods[lod].indexCount;
+        }
+    }
+    std::cout << "Index buffer: " << indexData.size()/1024 << " KiB, " 
+        << ((int64_t)indexCount*4 - (int64_t)indexData.size())/1024 << " KiB saved by 16 bit indices" << std::endl;
+}
+void Engine::packMeshes(std::vector<Mesh>& meshes) {
+    // vertexOffset is added to gl_VertexIndex, so the shader pulls from the shared buffer unchanged
+    packGeometry(meshes, config.quantizeVertices, vertexData, indexData, meshRanges);
+    if (meshRanges.empty()) {
+        throw std::runtime_error("VK Error: no triangles to draw");
+    }
+}
+void Engine::createObjects() {
+    // the synthetic scene repeats its mesh drawCount times, loaded meshes are drawn once each
+    uint32_t objectCount = config.syntheticScene.has_value() ? config.syntheticScene->drawCount : (uint32_t)meshRanges.size();
+    // a batch is every instance of one mesh whatever its material, ordered so batches sharing an
+    // index type are adjacent and go into one multi-draw; the map counts instances per batch first
+    // and holds the batch index after that
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> batchIndices;
+    for (uint32_t i=0; i<objectCount; i++) {
+        uint32_t meshIndex = i%(uint32_t)meshRanges.size();
+        batchIndices[{meshRanges[meshIndex].indexSize, meshIndex}]++;
+    }
+    // the levels of detail of a mesh are consecutive batches, an instance is drawn by the batch of its level
+    uint32_t firstInstance = 0;
+    for (auto& [key, batchIndex]: batchIndices) {
+        uint32_t instanceCount = batchIndex;
+        batchIndex = (uint32_t)drawBatches.size();
+        uint32_t lodCount = config.lods ? meshRanges[key.second].lodCount : 1;
+        for (uint32_t lod=0; lod<lodCount; lod++) {
+            drawBatches.push_back(DrawBatch{
+                .meshIndex = key.second,
+                .lod = lod,
+                .firstInstance = firstInstance,
+                .instanceCount = instanceCount
+            });
+            firstInstance += instanceCount;
+        }
+    }
+    visibleInstanceCapacity = firstInstance;
+    // laid out on a grid filling [-1, 1]^2 of the z=0 plane, a single object stays at the origin unscaled;
+    // the animated root holds a node per grid row, which holds the row's instances
+    uint32_t side = (uint32_t)std::ceil(std::sqrt((double)objectCount));
+    float spacing = 2.0f/side;
+    float scale = std::min(1.0f, spacing*0.9f);
+    sceneRoot = scene.addNode(SceneGraph::NO_PARENT, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    std::vector<uint32_t> rowNodes;
+    for (uint32_t row=0; row*side<objectCount; row++) {
+        glm::vec3 position(0.0f, (row + 0.5f)*spacing - 1.0f, 0.0f);
+        rowNodes.push_back(scene.addNode(sceneRoot, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)));
+    }
+    objects.resize(objectCount);
+    instanceNodes.resize(objectCount);
+    instanceLods.assign(objectCount, 0);
+    instanceMaterials.resize(objectCount);
+    objectBounds.resize(objectCount);
+    for (uint32_t i=0; i<objectCount; i++) {
+        uint32_t meshIndex = i%(uint32_t)meshRanges.size();
+        const MeshRange& mesh = meshRanges[meshIndex];
+        objects[i] = GpuObject{
+            .boundsCenter = {mesh.boundsCenter[0], mesh.boundsCenter[1], mesh.boundsCenter[2]},
+            .boundsRadius = mesh.boundsRadius,
+            .meshIndex = meshIndex,
+            .batch = batchIndices[{mesh.indexSize, meshIndex}]
+        };
+        instanceMaterials[i] = i%(uint32_t)materials.size();
+        glm::vec3 position((i%side + 0.5f)*spacing - 1.0f, 0.0f, 0.0f);
+        instanceNodes[i] = scene.addNode(rowNodes[i/side], position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(scale));
+    }
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | 
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkDeviceSize objectBytes = objects.size()*sizeof(GpuObject);
+    createBuffer(objectBuffer, objectBufferMemory, objectBytes, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    UploadTicket objectTicket = uploadBuffer(objectBuffer, 0, objects.data(), objectBytes);
+    VkDeviceSize meshBytes = meshRanges.size()*sizeof(MeshRange);
+    createBuffer(meshBuffer, meshBufferMemory, meshBytes, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    UploadTicket meshTicket = uploadBuffer(meshBuffer, 0, meshRanges.data(), meshBytes);
+    // both tables are part of the geometry, and so is the texture every material falls back to:
+    // nothing is drawn or culled before they arrive
+    geometryTicket.transferValue = std::max({geometryTicket.transferValue, objectTicket.transferValue, meshTicket.transferValue,
+        fallbackTexture.ticket.transferValue});
+    pushConstants.objectBufferAddress = getBufferAddress(objectBuffer);
+    pushConstants.meshBufferAddress = getBufferAddress(meshBuffer);
+    std::cout << objects.size() << " instances in " << drawBatches.size() << " instanced draws, " 
+        << (gpuCulling ? "culled on the GPU" : "culled on the CPU with " + std::string(getCullKernelName(getCullKernel()))) << std::endl;
+}
+void Engine::createIndirectBuffers() {
+    if (!gpuCulling) {
+        return;
+    }
+    // the commands with zero instances, copied over the frame's commands before culling
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    for (auto& batch: drawBatches) {
+        const MeshRange& mesh = meshRanges[batch.meshIndex];
+        commands.push_back(VkDrawIndexedIndirectCommand{
+            .indexCount = mesh.lods[batch.lod].indexCount,
+            .instanceCount = 0,
+            .firstIndex = mesh.lods[batch.lod].firstIndex,
+            .vertexOffset = mesh.vertexOffset,
+            .firstInstance = batch.firstInstance
+        });
+    }
+    VkDeviceSize commandBytes = commands.size()*sizeof(VkDrawIndexedIndirectCommand);
+    createBuffer(drawCommandTemplate, drawCommandTemplateMemory, commandBytes, 
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    UploadTicket templateTicket = uploadBuffer(drawCommandTemplate, 0, commands.data(), commandBytes);
+    geometryTicket.transferValue = std::max(geometryTicket.transferValue, templateTicket.transferValue);
+
+    // commands first, the visible instance list 16 byte aligned after them for the shaders' buffer reference
+    visibleInstanceOffset = (commandBytes + 15)/16*16;
+    VkDeviceSize size = visibleInstanceOffset + visibleInstanceCapacity*sizeof(uint32_t);
+    indirectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    indirectBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    indirectBufferAddresses.resize(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i=0; i<MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(indirectBuffers[i], indirectBufferMemory[i], size, 
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | 
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        indirectBufferAddresses[i] = getBufferAddress(indirectBuffers[i]);
+        // a slot holds valid zero instance commands even before its first reset
+        UploadTicket commandTicket = uploadBuffer(indirectBuffers[i], 0, commands.data(), commandBytes);
+        geometryTicket.transferValue = std::max(geometryTicket.transferValue, commandTicket.transferValue);
+    }
+}
+void Engine::destroyIndirectBuffers() {
+    for (uint32_t i=0; i<indirectBuffers.size(); i++) {
+        vkDestroyBuffer(device, indirectBuffers[i], nullptr);
+        allocator.free(indirectBufferMemory[i]);
+    }
+    indirectBuffers.clear();
+    indirectBufferMemory.clear();
+    indirectBufferAddresses.clear();
+    vkDestroyBuffer(device, drawCommandTemplate, nullptr);
+    allocator.free(drawCommandTemplateMemory);
+    drawCommandTemplate = VK_NULL_HANDLE;
+}
+Mesh Engine::createSyntheticMesh() {
+    // a grid in the z=0 plane cut down to exactly triangleCount triangles
+    uint32_t triangleCount = std::max(config.syntheticScene->triangleCount, 1u);
+    uint32_t cells = (triangleCount+1)/2;
+    uint32_t cols = (uint32_t)std::ceil(std::sqrt((double)cells));
+    uint32_t rows = (cells+cols-1)/cols;
+    Mesh mesh;
+    mesh.name = "synthetic grid";
+    for (uint32_t y=0; y<=rows; y++) {
+        for (uint32_t x=0; x<=cols; x++) {
+            float u = (float)x/cols;
+            float v = (float)y/rows;
+            mesh.vertices.push_back(Vertex{u-0.5f, v-0.5f, 0.0f, 0.0f, 0.0f, 1.0f, u, v});
+        }
+    }
+    for (uint32_t y=0; y<rows; y++) {
+        for (uint32_t x=0; x<cols; x++) {
+            uint32_t i0 = y*(cols+1)+x;
+            uint32_t i1 = i0+1;
+            uint32_t i2 = i0+cols+1;
+            uint32_t i3 = i2+1;
+            mesh.indices.insert(mesh.indices.end(), {i0, i1, i3, i3, i2, i0});
+        }
+    }
+    mesh.indices.resize(triangleCount*3);
+    return mesh;
+}
+bool Engine::supportsTextureFormat(VkFormat format) {
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(pDevice, format, &formatProps);
+    VkFormatFeatureFlags textureFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | 
+        VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (formatProps.optimalTilingFeatures & textureFeatures) == textureFeatures;
+}
+bool Engine::supportsMipBlits(VkFormat format) {
+    // linear blits need both blit features and linear filtering of the source
+    VkFormatProperties formatProps;
+    vkGetPhysicalDeviceFormatProperties(pDevice, format, &formatProps);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | 
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProps.optimalTilingFeatures & blitFeatures) == blitFeatures;
+}
+VkSampler Engine::getTextureSampler(uint32_t mipLevels) {
+    auto it = textureSamplers.find(mipLevels);
+    if (it != textureSamplers.end()) {
+        return it->second;
+    }
     VkPhysicalDeviceProperties props{};
     vkGetPhysicalDeviceProperties(pDevice, &props);
+    VkPhysicalDeviceFeatures features{};
+    vkGetPhysicalDeviceFeatures(pDevice, &features);
     VkSamplerCreateInfo samplerCI{
         .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
         .pNext = nullptr,
@@ -918,18 +1735,22 @@ void Engine::createTextureSampler() {
         .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
         .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
         .mipLodBias = 0.0f,
-        .anisotropyEnable = VK_TRUE,
+        .anisotropyEnable = features.samplerAnisotropy,
         .maxAnisotropy = props.limits.maxSamplerAnisotropy,
         .compareEnable = VK_FALSE,
         .compareOp = VK_COMPARE_OP_ALWAYS,
         .minLod = 0.0f,
-        .maxLod = 1.0f,
+        .maxLod = (float)(mipLevels - 1),
         .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
         .unnormalizedCoordinates = VK_FALSE
     };
-    VK_CHECK(vkCreateSampler(device, &samplerCI, nullptr, &textureSampler));
+    VkSampler sampler;
+    VK_CHECK(vkCreateSampler(device, &samplerCI, nullptr, &sampler));
+    textureSamplers[mipLevels] = sampler;
+    return sampler;
 }
-void Engine::createImage(VkImage& image, VkDeviceMemory& imageMemory, VkFormat format, VkExtent3D extent, VkImageUsageFlags usage) {
+void Engine::createImage(VkImage& image, Allocation& imageMemory, VkFormat format, VkExtent3D extent, VkImageUsageFlags usage,
+    VkSampleCountFlagBits samples, uint32_t mipLevels) {
     VkImageCreateInfo imageCI{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext = nullptr,
@@ -937,9 +1758,9 @@ void Engine::createImage(VkImage& image, VkDeviceMemory& imageMemory, VkFormat f
         .imageType = VK_IMAGE_TYPE_2D,
         .format = format,
         .extent = extent,
-        .mipLevels = 1,
+        .mipLevels = mipLevels,
         .arrayLayers = 1,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .samples = samples,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .usage = usage,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
@@ -948,28 +1769,7 @@ void Engine::createImage(VkImage& image, VkDeviceMemory& imageMemory, VkFormat f
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
     };
     VK_CHECK(vkCreateImage(device, &imageCI, nullptr, &image));
-
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocateInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = nullptr,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = getMemoryTypeIndex(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    VK_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory));
-
-    VK_CHECK(vkBindImageMemory(device, image, imageMemory, 0));
-}
-void Engine::createColorAttachment() {
-    createImage(colorImage, colorImageMemory, swapchainFormat, 
-        VkExtent3D{.width = swapchainExtent.width, .height = swapchainExtent.height, .depth = 1}, 
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-    createImageView(colorImage, colorImageView, VK_IMAGE_ASPECT_COLOR_BIT, swapchainFormat);
-    VkCommandBuffer cmdBuffer = beginSingleCommandRecording(gfxCmdPool);
-    transitionImageLayout(colorImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, cmdBuffer);
-    endSingleCommandRecording(cmdBuffer, gfxQueue);
+    imageMemory = allocator.allocateImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
 void Engine::createDepthAttachment() {
 
@@ -1009,19 +1809,40 @@ bool Engine::checkDeviceExtensionsSupport(VkPhysicalDevice dev) {
     return requested.empty();
 }
 bool Engine::isDeviceSuitable(VkPhysicalDevice dev) {
-    VkPhysicalDeviceProperties props{};
-    vkGetPhysicalDeviceProperties(dev, &props);
-    VkPhysicalDeviceFeatures features{};
-    vkGetPhysicalDeviceFeatures(dev, &features);
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(dev, &features2);
+    bool bindless = features12.runtimeDescriptorArray && features12.shaderSampledImageArrayNonUniformIndexing && 
+        features12.descriptorBindingPartiallyBound && features12.descriptorBindingSampledImageUpdateAfterBind && 
+        features12.descriptorBindingUpdateUnusedWhilePending;
 
     QueueFamilyIndices indices = getQueueFamilyIndices(dev);
+    if (!features2.features.multiDrawIndirect || !bindless || !indices.isComplete(!config.headless) || 
+        !checkDeviceExtensionsSupport(dev)) {
+        return false;
+    }
+    if (config.headless) {
+        return true;
+    }
     SurfaceDetails details = getSurfaceDetails(dev);
-
-    return features.multiDrawIndirect && 
-        props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && 
-        indices.isComplete() &&
-        checkDeviceExtensionsSupport(dev) &&
-        !details.formats.empty() && !details.modes.empty();
+    return !details.formats.empty() && !details.modes.empty();
+}
+int Engine::getDeviceScore(VkPhysicalDevice dev) {
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(dev, &props);
+    if (config.devicePolicy == DevicePolicy::DiscreteOnly) {
+        return props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? 0 : -1;
+    }
+    switch (props.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+        default: return 0;
+    }
 }
 QueueFamilyIndices Engine::getQueueFamilyIndices(VkPhysicalDevice dev) {
     uint32_t count;
@@ -1038,13 +1859,20 @@ QueueFamilyIndices Engine::getQueueFamilyIndices(VkPhysicalDevice dev) {
         if (!(queue.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queue.queueFlags & VK_QUEUE_TRANSFER_BIT)) {
             indices.transferFamily = i;
         }
-        VkBool32 presentSupported;
-        vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupported);
-        if (presentSupported) {
-            indices.presentFamily = i;
+        if (!config.headless) {
+            VkBool32 presentSupported;
+            vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupported);
+            if (presentSupported) {
+                indices.presentFamily = i;
+            }
         }
         i++;
     }
+    // software and most integrated implementations expose a single family, so transfers
+    // go through the graphics queue there
+    if (!indices.transferFamily.has_value()) {
+        indices.transferFamily = indices.graphicsFamily;
+    }
     return indices;
 }
 SurfaceDetails Engine::getSurfaceDetails(VkPhysicalDevice dev) {
@@ -1103,7 +1931,15 @@ VkCommandBuffer Engine::allocateCommandBuffer(VkCommandPool& cmdPool) {
     VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &cmdBuffer));
     return cmdBuffer;
 }
-uint32_t Engine::getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags memProperties) {
+VkDeviceAddress Engine::getBufferAddress(VkBuffer& buffer) {
+    VkBufferDeviceAddressInfo bdaInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = nullptr,
+        .buffer = buffer
+    };
+    return vkGetBufferDeviceAddress(device, &bdaInfo);
+}
+std::optional<uint32_t> Engine::findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags memProperties) {
     VkPhysicalDeviceMemoryProperties pDeviceMemProps{};
     vkGetPhysicalDeviceMemoryProperties(pDevice, &pDeviceMemProps);
     for (uint32_t i=0; i<pDeviceMemProps.memoryTypeCount; i++) {
@@ -1111,17 +1947,305 @@ uint32_t Engine::getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags m
             return i;
         }
     }
-    throw std::runtime_error("VK Error: no suitable memory type for buffer");
+    return std::nullopt;
 }
-void Engine::copyBuffer(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size) {
+void Engine::copyBuffer(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkDeviceSize srcOffset, VkBuffer& dstBuffer, 
+    VkDeviceSize dstOffset, VkDeviceSize size) {
     VkBufferCopy region{
-        .srcOffset = 0,
-        .dstOffset = 0,
+        .srcOffset = srcOffset,
+        .dstOffset = dstOffset,
         .size = size
     };
     vkCmdCopyBuffer(cmdBuffer, srcBuffer, dstBuffer, 1, &region);
 }
-void Engine::copyBufferToImage(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkImage& dstImage, uint32_t width, uint32_t height) {
+void Engine::copyBufferToImage(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkDeviceSize srcOffset, VkImage& dstImage, 
+    uint32_t width, uint32_t y, uint32_t rows, uint32_t mipLevel) {
+    VkBufferImageCopy region{
+        .bufferOffset = srcOffset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = mipLevel,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset{
+            .x = 0,
+            .y = (int32_t)y,
+            .z = 0,
+        },
+        .imageExtent{
+            .width = width,
+            .height = rows,
+            .depth = 1
+        }
+    };
+    vkCmdCopyBufferToImage(cmdBuffer, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+UploadTicket Engine::uploadBuffer(VkBuffer& dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    for (VkDeviceSize done=0; done<size; done+=STAGING_CHUNK_SIZE) {
+        VkDeviceSize chunk = std::min(size-done, STAGING_CHUNK_SIZE);
+        StagingRegion region = stageUpload(chunk);
+        memcpy(region.data, static_cast<const char*>(data)+done, (size_t)chunk);
+        VkCommandBuffer cmdBuffer = getUploadCmdBuffer();
+        copyBuffer(cmdBuffer, region.buffer, region.offset, dstBuffer, dstOffset+done, chunk);
+    }
+    // within one family the semaphore wait of the acquire submit is all the graphics queue needs
+    if (queueFamilyIndices.transferFamily != queueFamilyIndices.graphicsFamily) {
+        uploadBufferBarriers.push_back(VkBufferMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+            .pNext = nullptr,
+            .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .dstAccessMask = VK_ACCESS_2_NONE,
+            .srcQueueFamilyIndex = queueFamilyIndices.transferFamily.value(),
+            .dstQueueFamilyIndex = queueFamilyIndices.graphicsFamily.value(),
+            .buffer = dstBuffer,
+            .offset = dstOffset,
+            .size = size
+        });
+    }
+    return UploadTicket{.transferValue = transferTimelineValue+1};
+}
+UploadTicket Engine::uploadImage(VkImage& image, VkFormat format, const std::vector<TextureLevel>& levels, uint32_t mipLevels) {
+    TextureFormatInfo info = getTextureFormatInfo(format).value();
+    uint32_t width = levels[0].width;
+    uint32_t height = levels[0].height;
+    VkCommandBuffer cmdBuffer = getUploadCmdBuffer();
+    transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cmdBuffer);
+    for (uint32_t level=0; level<levels.size(); level++) {
+        uploadImageLevel(image, info, levels[level], level);
+    }
+    // blits need a graphics queue, so they wait for the acquire; the CPU chain is uploaded with level 0
+    bool fillLevels = mipLevels > levels.size();
+    bool blit = fillLevels && supportsMipBlits(format) && !config.cpuMipFilter.has_value();
+    if (blit) {
+        uploadMipBlits.push_back(MipBlit{.image = image, .width = width, .height = height, .mipLevels = mipLevels});
+        textureStats.blitTextures++;
+    } else if (fillLevels) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<MipLevel> mipChain = generateMipChain(levels[0].data, width, height, config.cpuMipFilter.value_or(MipFilter::Box), 
+            &threadPool);
+        textureStats.cpuMipMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        textureStats.cpuTextures++;
+        for (uint32_t level=1; level<mipLevels; level++) {
+            const MipLevel& mip = mipChain[level-1];
+            uploadImageLevel(image, info, TextureLevel{.width = mip.width, .height = mip.height, .data = mip.pixels.data(), 
+                .size = mip.pixels.size()}, level);
+        }
+    }
+    // the layout change to SHADER_READ_ONLY is part of the release/acquire pair, or of the blits
+    // for images that still need them
+    bool transferOwnership = queueFamilyIndices.transferFamily != queueFamilyIndices.graphicsFamily;
+    uploadImageBarriers.push_back(VkImageMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = blit ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = transferOwnership ? queueFamilyIndices.transferFamily.value() : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transferOwnership ? queueFamilyIndices.graphicsFamily.value() : VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    });
+    return UploadTicket{.transferValue = transferTimelineValue+1};
+}
+void Engine::uploadImageLevel(VkImage& image, const TextureFormatInfo& info, const TextureLevel& level, uint32_t mipLevel) {
+    // chunks are whole rows of blocks so each one is a single buffer to image copy
+    VkDeviceSize rowSize = getTextureLevelSize(info, level.width, 1);
+    uint32_t blockRows = (level.height + info.blockHeight - 1)/info.blockHeight;
+    uint32_t rowsPerChunk = (uint32_t)std::max<VkDeviceSize>(STAGING_CHUNK_SIZE/rowSize, 1);
+    for (uint32_t y=0; y<blockRows; y+=rowsPerChunk) {
+        uint32_t rows = std::min(rowsPerChunk, blockRows-y);
+        StagingRegion region = stageUpload(rowSize*rows);
+        memcpy(region.data, level.data+y*rowSize, (size_t)(rowSize*rows));
+        VkCommandBuffer cmdBuffer = getUploadCmdBuffer();
+        // the copy is in texels, the last row of blocks may hang over the bottom of the level
+        uint32_t texelY = y*info.blockHeight;
+        copyBufferToImage(cmdBuffer, region.buffer, region.offset, image, level.width, texelY, 
+            std::min(rows*info.blockHeight, level.height-texelY), mipLevel);
+    }
+}
+bool Engine::isUploadReady(UploadTicket ticket) {
+    return ticket.transferValue <= acquiredTransferValue;
+}
+void Engine::waitUploads() {
+    flushUploads();
+    waitTimeline(transferTimeline, transferTimelineValue);
+    processUploads();
+}
+StagingRegion Engine::stageUpload(VkDeviceSize size) {
+    while (true) {
+        // 16 satisfies the copy offset rules for every format uploaded here
+        std::optional<StagingRegion> region = stagingRing.allocate(size, 16);
+        if (region.has_value()) {
+            return region.value();
+        }
+        // ring is full: submit what's recorded and wait for the oldest batch to free its space
+        flushUploads();
+        uint64_t oldest = stagingRing.getOldestValue();
+        if (oldest == 0) {
+            throw std::runtime_error("VK Error: upload does not fit into the staging ring");
+        }
+        PROFILE_SCOPE(profiler, "staging ring wait");
+        waitTimeline(transferTimeline, oldest);
+        processUploads();
+    }
+}
+VkCommandBuffer Engine::getUploadCmdBuffer() {
+    if (uploadCmdBuffer == VK_NULL_HANDLE) {
+        uploadCmdBuffer = beginSingleCommandRecording(transferCmdPool);
+    }
+    return uploadCmdBuffer;
+}
+void Engine::flushUploads() {
+    if (uploadCmdBuffer == VK_NULL_HANDLE) {
+        return;
+    }
+    VkDependencyInfo dependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = (uint32_t)uploadBufferBarriers.size(),
+        .pBufferMemoryBarriers = uploadBufferBarriers.data(),
+        .imageMemoryBarrierCount = (uint32_t)uploadImageBarriers.size(),
+        .pImageMemoryBarriers = uploadImageBarriers.data()
+    };
+    vkCmdPipelineBarrier2(uploadCmdBuffer, &dependencyInfo);
+    vkEndCommandBuffer(uploadCmdBuffer);
+    uint64_t value = ++transferTimelineValue;
+    submitWithTimeline(uploadCmdBuffer, transferQueue, VK_NULL_HANDLE, 0, transferTimeline, value);
+    stagingRing.tag(value);
+    uploadBatches.push_back(UploadBatch{
+        .transferCmdBuffer = uploadCmdBuffer,
+        .transferValue = value,
+        .bufferBarriers = std::move(uploadBufferBarriers),
+        .imageBarriers = std::move(uploadImageBarriers),
+        .mipBlits = std::move(uploadMipBlits)
+    });
+    uploadBufferBarriers.clear();
+    uploadImageBarriers.clear();
+    uploadMipBlits.clear();
+    uploadCmdBuffer = VK_NULL_HANDLE;
+}
+void Engine::processUploads() {
+    // batches are acquired only after their transfer finished, so the graphics queue never
+    // stalls on the semaphore wait and frames keep going while assets stream in
+    uint64_t completedTransfer = getCompletedTimelineValue(transferTimeline);
+    stagingRing.retire(completedTransfer);
+    for (auto& batch: uploadBatches) {
+        if (batch.transferValue > completedTransfer) {
+            break;
+        }
+        if (batch.acquireValue == 0) {
+            acquireUploads(batch);
+        }
+    }
+    uint64_t completed = getCompletedTimelineValue();
+    while (!uploadBatches.empty() && uploadBatches.front().acquireValue != 0 && uploadBatches.front().acquireValue <= completed) {
+        UploadBatch& batch = uploadBatches.front();
+        vkFreeCommandBuffers(device, transferCmdPool, 1, &batch.transferCmdBuffer);
+        if (batch.acquireCmdBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, gfxCmdPool, 1, &batch.acquireCmdBuffer);
+        }
+        uploadBatches.pop_front();
+    }
+}
+void Engine::acquireUploads(UploadBatch& batch) {
+    // acquire barriers repeat the release with the stage and access halves swapped, images
+    // that stayed in one family were already transitioned completely by the release
+    std::erase_if(batch.imageBarriers, [](const VkImageMemoryBarrier2& barrier) {
+        return barrier.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED;
+    });
+    for (auto& barrier: batch.bufferBarriers) {
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+    for (auto& barrier: batch.imageBarriers) {
+        // images still in TRANSFER_DST are read and written by their mip blits next
+        bool blit = barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        barrier.dstStageMask = blit ? VK_PIPELINE_STAGE_2_TRANSFER_BIT : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.dstAccessMask = blit ? VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_SHADER_READ_BIT;
+    }
+    if (!batch.bufferBarriers.empty() || !batch.imageBarriers.empty() || !batch.mipBlits.empty()) {
+        batch.acquireCmdBuffer = beginSingleCommandRecording(gfxCmdPool);
+        VkDependencyInfo dependencyInfo{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = nullptr,
+            .dependencyFlags = 0,
+            .memoryBarrierCount = 0,
+            .pMemoryBarriers = nullptr,
+            .bufferMemoryBarrierCount = (uint32_t)batch.bufferBarriers.size(),
+            .pBufferMemoryBarriers = batch.bufferBarriers.data(),
+            .imageMemoryBarrierCount = (uint32_t)batch.imageBarriers.size(),
+            .pImageMemoryBarriers = batch.imageBarriers.data()
+        };
+        vkCmdPipelineBarrier2(batch.acquireCmdBuffer, &dependencyInfo);
+        for (const MipBlit& blit: batch.mipBlits) {
+            recordMipBlits(batch.acquireCmdBuffer, blit);
+        }
+        vkEndCommandBuffer(batch.acquireCmdBuffer);
+    }
+    batch.acquireValue = ++timelineValue;
+    submitWithTimeline(batch.acquireCmdBuffer, gfxQueue, transferTimeline, batch.transferValue, timeline, batch.acquireValue);
+    // every later graphics submit is ordered behind the acquire
+    acquiredTransferValue = batch.transferValue;
+}
+void Engine::recordMipBlits(VkCommandBuffer& cmdBuffer, const MipBlit& blit) {
+    // each level is halved from the one above it, which moves on to SHADER_READ_ONLY once read
+    int32_t width = (int32_t)blit.width;
+    int32_t height = (int32_t)blit.height;
+    for (uint32_t level=1; level<blit.mipLevels; level++) {
+        VkImage image = blit.image;
+        transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cmdBuffer, 
+            VK_IMAGE_ASPECT_COLOR_BIT, level-1, 1);
+        int32_t levelWidth = std::max(width/2, 1);
+        int32_t levelHeight = std::max(height/2, 1);
+        VkImageBlit region{
+            .srcSubresource{
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level-1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            },
+            .srcOffsets{{0, 0, 0}, {width, height, 1}},
+            .dstSubresource{
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            },
+            .dstOffsets{{0, 0, 0}, {levelWidth, levelHeight, 1}}
+        };
+        vkCmdBlitImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+            1, &region, VK_FILTER_LINEAR);
+        transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer, 
+            VK_IMAGE_ASPECT_COLOR_BIT, level-1, 1);
+        width = levelWidth;
+        height = levelHeight;
+    }
+    VkImage image = blit.image;
+    transitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, cmdBuffer, 
+        VK_IMAGE_ASPECT_COLOR_BIT, blit.mipLevels-1, 1);
+}
+void Engine::copyImageToBuffer(VkCommandBuffer& cmdBuffer, VkImage& srcImage, VkBuffer& dstBuffer, uint32_t width, uint32_t height) {
     VkBufferImageCopy region{
         .bufferOffset = 0,
         .bufferRowLength = 0,
@@ -1143,18 +2267,145 @@ void Engine::copyBufferToImage(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer,
             .depth = 1
         }
     };
-    vkCmdCopyBufferToImage(cmdBuffer, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdCopyImageToBuffer(cmdBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &region);
 }
-void Engine::updateMVP(uint32_t index) {
+void Engine::updateMVP() {
     MVP mvp;
     static auto startTime = std::chrono::high_resolution_clock::now();
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-    mvp.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    if (config.fixedTimestep.has_value()) {
+        time = frameNumber*config.fixedTimestep.value();
+    }
     mvp.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     mvp.proj = glm::perspective(glm::radians(45.0f), (float)swapchainExtent.width/swapchainExtent.height, 0.1f, 10.0f);
     mvp.proj[1][1]*=-1;
-    memcpy(MVPBufferMemoryMapped[index], &mvp, sizeof(MVP));
+    mvpOffset = (uint32_t)frameAllocator.push(mvp).offset;
+    updateMaterials();
+    scene.setRotation(sceneRoot, glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+    {
+        PROFILE_SCOPE(profiler, "scene update");
+        scene.update(&threadPool);
+    }
+    updateInstances(mvp);
+}
+void Engine::updateInstances(const MVP& mvp) {
+    FrameAllocation instanceAllocation = frameAllocator.allocate(objects.size()*sizeof(GpuInstance));
+    GpuInstance* instances = static_cast<GpuInstance*>(instanceAllocation.data);
+    pushConstants.instanceBufferAddress = instanceAllocation.address;
+    glm::vec3 eye = glm::vec3(glm::inverse(mvp.view)[3]);
+    // pixels covered by one unit at distance one
+    float pixelsPerUnit = std::abs(mvp.proj[1][1])*swapchainExtent.height*0.5f;
+    std::atomic<uint64_t> triangles = 0;
+    std::atomic<uint64_t> fullDetailTriangles = 0;
+    threadPool.parallelFor(objects.size(), 16384, [&](size_t begin, size_t end) {
+        uint64_t chunkTriangles = 0;
+        uint64_t chunkFullDetailTriangles = 0;
+        for (size_t i=begin; i<end; i++) {
+            const glm::mat4& model = scene.worldMatrices[instanceNodes[i]];
+            GpuInstance instance;
+            for (int row=0; row<3; row++) {
+                for (int column=0; column<4; column++) {
+                    instance.transform[row][column] = model[column][row];
+                }
+            }
+            instance.materialIndex = instanceMaterials[i];
+            // world space spheres, the same transform cull.comp applies
+            glm::vec3 center = glm::vec3(model*glm::vec4(objects[i].boundsCenter[0], objects[i].boundsCenter[1], 
+                objects[i].boundsCenter[2], 1.0f));
+            float maxScale = std::sqrt(std::max({glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))}));
+            float radius = objects[i].boundsRadius*maxScale;
+            if (!gpuCulling) {
+                objectBounds.set(i, &center.x, radius);
+            }
+            const MeshRange& mesh = meshRanges[objects[i].meshIndex];
+            uint32_t lod = instanceLods[i];
+            if (config.lods) {
+                // a level's screen-space error is error*maxScale*pixelsPerUnit/distance, compared multiplied
+                // out by the distance to the sphere, which is negative inside it and forces full detail
+                float distance = glm::length(center - eye) - radius;
+                float errorScale = maxScale*pixelsPerUnit;
+                float finerThreshold = config.lodErrorPixels*(1.0f + LOD_HYSTERESIS)*distance;
+                float coarserThreshold = config.lodErrorPixels*(1.0f - LOD_HYSTERESIS)*distance;
+                while (lod > 0 && mesh.lods[lod].error*errorScale > finerThreshold) {
+                    lod--;
+                }
+                while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error*errorScale < coarserThreshold) {
+                    lod++;
+                }
+                instanceLods[i] = lod;
+            }
+            instance.lod = lod;
+            chunkTriangles += mesh.lods[lod].indexCount/3;
+            chunkFullDetailTriangles += mesh.lods[0].indexCount/3;
+            // whole structs only, the mapping may be write-combined
+            instances[i] = instance;
+        }
+        triangles += chunkTriangles;
+        fullDetailTriangles += chunkFullDetailTriangles;
+    });
+    lodStats.frames++;
+    lodStats.triangles += triangles;
+    lodStats.fullDetailTriangles += fullDetailTriangles;
+    Frustum frustum = getFrustum(mvp.proj*mvp.view);
+    if (gpuCulling) {
+        CullData cullData{
+            .frustum = frustum,
+            .objectCount = (uint32_t)objects.size()
+        };
+        cullDataAddress = frameAllocator.push(cullData).address;
+        pushConstants.visibleInstanceAddress = indirectBufferAddresses[currFrame] + visibleInstanceOffset;
+        buildDrawList();
+        return;
+    }
+    {
+        PROFILE_SCOPE(profiler, "cpu cull");
+        cullSpheres(objectBounds, frustum, visibleObjects, &threadPool);
+    }
+    // the visible indices are ascending, so bucketing them keeps every batch's list in order too
+    FrameAllocation visibleAllocation = frameAllocator.allocate(visibleInstanceCapacity*sizeof(uint32_t));
+    uint32_t* visibleInstances = static_cast<uint32_t*>(visibleAllocation.data);
+    pushConstants.visibleInstanceAddress = visibleAllocation.address;
+    visibleInstanceCounts.assign(drawBatches.size(), 0);
+    batchDepths.assign(drawBatches.size(), std::numeric_limits<float>::max());
+    for (uint32_t i: visibleObjects) {
+        uint32_t batch = objects[i].batch + instanceLods[i];
+        visibleInstances[drawBatches[batch].firstInstance + visibleInstanceCounts[batch]++] = i;
+        // distance along the view direction, the view space z of the center negated
+        float depth = -(mvp.view[0][2]*objectBounds.centerX[i] + mvp.view[1][2]*objectBounds.centerY[i] + 
+            mvp.view[2][2]*objectBounds.centerZ[i] + mvp.view[3][2]);
+        batchDepths[batch] = std::min(batchDepths[batch], depth);
+    }
+    buildDrawList();
+}
+void Engine::buildDrawList() {
+    // one pass and one pipeline for now, the index type is the only state that changes between draws
+    drawList.clear();
+    if (gpuCulling) {
+        // the indirect commands are in batch order, so a multi-draw covers a run of consecutive batches
+        // and is drawn at depth zero: the instance counts aren't known before cull.comp runs
+        for (uint32_t first=0; first<drawBatches.size();) {
+            uint32_t indexSize = meshRanges[drawBatches[first].meshIndex].indexSize;
+            uint32_t last = first + 1;
+            while (last < drawBatches.size() && meshRanges[drawBatches[last].meshIndex].indexSize == indexSize) {
+                last++;
+            }
+            drawList.push(makeSortKey(DrawPass::Opaque, 0, indexSize, 0.0f), first, last - first);
+            first = last;
+        }
+    } else {
+        for (uint32_t batch=0; batch<drawBatches.size(); batch++) {
+            if (visibleInstanceCounts[batch] > 0) {
+                uint32_t indexSize = meshRanges[drawBatches[batch].meshIndex].indexSize;
+                drawList.push(makeSortKey(DrawPass::Opaque, 0, indexSize, batchDepths[batch]), batch);
+            }
+        }
+    }
+    PROFILE_SCOPE(profiler, "draw sort");
+    auto startTime = std::chrono::high_resolution_clock::now();
+    drawList.sort(&threadPool);
+    drawStats.sortMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
 }
 VkCommandBuffer Engine::beginSingleCommandRecording(VkCommandPool& cmdPool) {
     VkCommandBuffer cmdBuffer = allocateCommandBuffer(cmdPool);
@@ -1168,74 +2419,158 @@ VkCommandBuffer Engine::beginSingleCommandRecording(VkCommandPool& cmdPool) {
     vkBeginCommandBuffer(cmdBuffer, &beginInfo);
     return cmdBuffer;
 }
-void Engine::endSingleCommandRecording(VkCommandBuffer& cmdBuffer, VkQueue& queue) {
-    vkEndCommandBuffer(cmdBuffer);
-
+void Engine::submitWithTimeline(VkCommandBuffer cmdBuffer, VkQueue& queue, VkSemaphore waitSemaphore, uint64_t waitValue,
+    VkSemaphore signalSemaphore, uint64_t signalValue) {
     VkCommandBufferSubmitInfo cmdBufferSubmitInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
         .pNext = nullptr,
         .commandBuffer = cmdBuffer,
         .deviceMask = 0
     };
+    VkSemaphoreSubmitInfo waitSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = waitSemaphore,
+        .value = waitValue,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+    };
+    // the main timeline is only signaled from gfxQueue, or waited on right away, so its values
+    // can't be reordered between queues; transferQueue has a timeline of its own
+    VkSemaphoreSubmitInfo signalSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = signalSemaphore,
+        .value = signalValue,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+    };
     VkSubmitInfo2 submitInfo{
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
         .pNext = nullptr,
         .flags = 0,
-        .waitSemaphoreInfoCount = 0,
-        .pWaitSemaphoreInfos = nullptr,
-        .commandBufferInfoCount = 1,
+        .waitSemaphoreInfoCount = waitSemaphore != VK_NULL_HANDLE ? 1u : 0u,
+        .pWaitSemaphoreInfos = &waitSubmitInfo,
+        .commandBufferInfoCount = cmdBuffer != VK_NULL_HANDLE ? 1u : 0u,
         .pCommandBufferInfos = &cmdBufferSubmitInfo,
-        .signalSemaphoreInfoCount = 0,
-        .pSignalSemaphoreInfos = nullptr
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &signalSubmitInfo
     };
-
-    VkFence fence;
-    createFence(fence, 0);
-    VK_CHECK(vkQueueSubmit2(queue, 1, &submitInfo, fence));
-    vkWaitForFences(device, 1, &fence, VK_TRUE, ~0ull);
-    vkDestroyFence(device, fence, nullptr);
-}
-void Engine::transitionImageLayout(VkImage& image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer& cmdBuffer) {
-    VkAccessFlags2 srcAccessMask;
-    VkAccessFlags2 dstAccessMask;
-    VkPipelineStageFlags2 srcStageMask;
-    VkPipelineStageFlags2 dstStageMask;
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-        srcAccessMask = VK_ACCESS_2_NONE;
-        srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
-        srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-        srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dstAccessMask = VK_ACCESS_2_NONE;
-        dstStageMask = VK_PIPELINE_STAGE_2_NONE;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        srcAccessMask = VK_ACCESS_2_NONE;
-        srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-        dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-        srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-        srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-        srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
-        srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-        srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        dstAccessMask = VK_ACCESS_2_NONE;
-        dstStageMask = VK_PIPELINE_STAGE_2_NONE;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-        srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VK_CHECK(vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE));
+}
+uint64_t Engine::getCompletedTimelineValue() {
+    return getCompletedTimelineValue(timeline);
+}
+uint64_t Engine::getCompletedTimelineValue(VkSemaphore semaphore) {
+    uint64_t value;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, semaphore, &value));
+    return value;
+}
+void Engine::waitTimeline(uint64_t value) {
+    waitTimeline(timeline, value);
+}
+void Engine::waitTimeline(VkSemaphore semaphore, uint64_t value) {
+    VkSemaphoreWaitInfo waitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &value
+    };
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, ~0ull));
+}
+void Engine::collectFrameLatency() {
+    // a frame is ready for present once its timeline value is reached; it is polled after the frame
+    // wait and after each present, so a latency can still run late by the time it takes to record a frame
+    uint64_t completed = getCompletedTimelineValue();
+    auto now = std::chrono::high_resolution_clock::now();
+    while (!pendingFrames.empty() && pendingFrames.front().timelineValue <= completed) {
+        const PendingFrame& frame = pendingFrames.front();
+        double ms = std::chrono::duration<double, std::milli>(now - frame.submitTime).count();
+        latencyStats[(size_t)frame.pacing].add(ms);
+        pendingFrames.pop_front();
+    }
+}
+void Engine::collectGpuTime(uint32_t frame) {
+    // the frame timer lives in the profiler's query pools and runs with the profiler disabled too
+    std::optional<double> ms = profiler.collectGpuFrame(frame);
+    if (ms.has_value()) {
+        gpuTimeStats[gpuFrameMsaa[frame] ? 1 : 0].add(ms.value());
+    }
+}
+VkSampleCountFlagBits Engine::getMaxMsaaSamples(VkSampleCountFlagBits limit) {
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    VkSampleCountFlags supported = props.limits.framebufferColorSampleCounts;
+    for (VkSampleCountFlags samples = limit; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1) {
+        if (supported & samples) {
+            return (VkSampleCountFlagBits)samples;
+        }
     }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+void Engine::printFrameReport() {
+    const char* names[] = {"low latency", "throughput"};
+    for (size_t i=0; i<2; i++) {
+        const TimingStats& stats = latencyStats[i];
+        if (stats.frames==0) {
+            continue;
+        }
+        std::cout << "Submit-to-present latency (" << names[i] << "): avg " << stats.totalMs/stats.frames 
+            << " ms, max " << stats.maxMs << " ms over " << stats.frames << " frames, polled twice per frame" << std::endl;
+    }
+    const char* paths[] = {"direct to swapchain", "MSAA resolve"};
+    for (size_t i=0; i<2; i++) {
+        const TimingStats& stats = gpuTimeStats[i];
+        if (stats.frames==0) {
+            continue;
+        }
+        std::cout << "GPU frame time (" << paths[i] << "): avg " << stats.totalMs/stats.frames 
+            << " ms, max " << stats.maxMs << " ms over " << stats.frames << " frames" << std::endl;
+    }
+    AllocatorStats memStats = allocator.getStats();
+    std::cout << "Device memory: " << memStats.bytesUsed/1024 << " KiB used of " << memStats.bytesReserved/1024 
+        << " KiB reserved (peak " << memStats.peakBytesReserved/1024 << " KiB), " << memStats.allocationCount 
+        << " allocations in " << memStats.blockCount << " blocks + " << memStats.dedicatedCount << " dedicated, "
+        << "fragmentation " << memStats.fragmentation << std::endl;
+    if (lodStats.frames > 0) {
+        std::cout << "Levels of detail: " << lodStats.triangles/lodStats.frames << " triangles per frame before culling, " 
+            << lodStats.fullDetailTriangles/lodStats.frames << " at full detail" << std::endl;
+    }
+    if (drawStats.frames > 0) {
+        std::cout << "Draw list: " << drawStats.packets/drawStats.frames << " packets per frame, " 
+            << drawStats.stateChanges/drawStats.frames << " state changes and " 
+            << drawStats.stateChangesAvoided/drawStats.frames << " avoided per frame, sorted in " 
+            << drawStats.sortMs/drawStats.frames << " ms" << std::endl;
+    }
+    std::cout << "Frame allocator: peak " << frameAllocator.peakBytes/1024 << " KiB of " 
+        << frameAllocator.sliceSize/1024 << " KiB per frame" << std::endl;
+    std::cout << "Texture slots: peak " << textureSlots.peakUsedCount << " of " << textureSlots.capacity << ", " 
+        << materials.size() << " materials" << std::endl;
+    std::cout << "Textures: " << textureStats.textures << " (" << textureStats.bytes/1024 << " KiB, " 
+        << textureStats.mipBytes/1024 << " KiB of it mip levels), " << textureStats.blitTextures << " mip chains blitted, " 
+        << textureStats.cpuTextures << " built on the CPU with the " << getMipFilterName(config.cpuMipFilter.value_or(MipFilter::Box)) 
+        << " filter in " << textureStats.cpuMipMs << " ms" << std::endl;
+    if (textureStats.compressedTextures + textureStats.decodedTextures > 0) {
+        std::cout << "Compressed textures: " << textureStats.compressedTextures << " block compressed, " 
+            << textureStats.decodedTextures << " decoded to RGBA8 in " << textureStats.decodeMs << " ms, " 
+            << textureStats.supercompressedTextures << " inflated in " << textureStats.inflateMs << " ms, "
+            << textureStats.rgba8Bytes/1024 << " KiB as RGBA8" << std::endl;
+    }
+    std::cout << "Render graph: " << renderGraph.passes.size() << " passes (" << renderGraph.culledPassCount << " culled), "
+        << renderGraph.transientBytes/1024 << " KiB of transient images, " << renderGraph.aliasedBytes/1024
+        << " KiB of it aliased" << std::endl;
+}
+void Engine::transitionImageLayout(VkImage& image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer& cmdBuffer,
+    VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t levelCount) {
+    // scopes come from what each layout is used for, the render graph tracks anything finer
+    UsageInfo src = getLayoutUsageInfo(oldLayout);
+    UsageInfo dst = getLayoutUsageInfo(newLayout);
+    VkAccessFlags2 srcAccessMask = src.write ? src.access : VK_ACCESS_2_NONE;
+    VkAccessFlags2 dstAccessMask = dst.access;
+    VkPipelineStageFlags2 srcStageMask = src.stage;
+    VkPipelineStageFlags2 dstStageMask = dst.stage;
 
     VkImageMemoryBarrier2 imageMemoryBarrier{
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
@@ -1250,11 +2585,11 @@ void Engine::transitionImageLayout(VkImage& image, VkImageLayout oldLayout, VkIm
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .image = image,
         .subresourceRange{
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
+            .aspectMask = aspectMask,
+            .baseMipLevel = baseMipLevel,
+            .levelCount = levelCount,
             .baseArrayLayer = 0,
-            .layerCount = 1
+            .layerCount = VK_REMAINING_ARRAY_LAYERS
         }
     };
     VkDependencyInfo dependencyInfo{
@@ -1269,33 +2604,4 @@ void Engine::transitionImageLayout(VkImage& image, VkImageLayout oldLayout, VkIm
         .pImageMemoryBarriers = &imageMemoryBarrier
     };
     vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
-}
-void Engine::copyImage(VkCommandBuffer& cmdBuffer, VkImage& srcImage, VkImage& dstImage, VkExtent3D extent) {
-    VkImageCopy region{
-        .srcSubresource{
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-        .srcOffset{
-            .x = 0,
-            .y = 0,
-            .z = 0
-        },
-        .dstSubresource{
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-        .dstOffset{
-            .x = 0,
-            .y = 0,
-            .z = 0
-        },
-        .extent = extent
-    };
-    vkCmdCopyImage(cmdBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstImage, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
\ No newline at end of file
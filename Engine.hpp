@@ -1,13 +1,29 @@
 #pragma once
 #include "config.hpp"
 #include "common.hpp"
+#include "Readback.hpp"
+#include "Allocator.hpp"
+#include "StagingRing.hpp"
+#include "RenderGraph.hpp"
+#include "FrameAllocator.hpp"
+#include "MeshLoader.hpp"
+#include "MeshPack.hpp"
+#include "MeshSimplifier.hpp"
+#include "ThreadPool.hpp"
+#include "Culling.hpp"
+#include "SceneGraph.hpp"
+#include "SlotAllocator.hpp"
+#include "DrawList.hpp"
+#include "Mipmaps.hpp"
+#include "Ktx2.hpp"
+#include "Profiler.hpp"
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
     std::optional<uint32_t> transferFamily;
-    bool isComplete() {
-        return graphicsFamily.has_value() && presentFamily.has_value() && transferFamily.has_value();
+    bool isComplete(bool needsPresent) {
+        return graphicsFamily.has_value() && (presentFamily.has_value() || !needsPresent) && transferFamily.has_value();
     }
 };
 struct SurfaceDetails {
@@ -15,25 +31,218 @@ struct SurfaceDetails {
     std::vector<VkSurfaceFormatKHR> formats;
     std::vector<VkPresentModeKHR> modes;
 };
-struct Vertex {
-    float vx, vy, vz;
-    float nx, ny, nz;
-    float u, v;
-};
+// render.vert maps gl_InstanceIndex through the visible instance list to an instance,
+// which leads to its transform, its object and from there to the mesh format
 struct PushConstants {
     VkDeviceAddress vertexBufferAddress;
+    VkDeviceAddress objectBufferAddress;
+    VkDeviceAddress meshBufferAddress;
+    // per frame, from the frame allocator or the frame's indirect buffer
+    VkDeviceAddress instanceBufferAddress;
+    VkDeviceAddress visibleInstanceAddress;
+    // the frame's GpuMaterial table, the only member render.frag reads
+    VkDeviceAddress materialBufferAddress;
+};
+// static part of an instance, read by cull.comp and render.vert, layout matches the shaders' Object
+struct GpuObject {
+    // bounding sphere in model space
+    float boundsCenter[3];
+    float boundsRadius;
+    uint32_t meshIndex;
+    uint32_t batch;
+};
+// per frame part of an instance, written into the frame allocator
+struct GpuInstance {
+    // rows of the affine model matrix
+    float transform[3][4];
+    // into the frame's material table
+    uint32_t materialIndex;
+    // level of detail picked this frame, the instance is drawn by batch object.batch + lod
+    uint32_t lod;
+};
+// every instance of one mesh at one level of detail, drawn by a single instanced draw whatever
+// their materials, textures come from the bindless array
+struct DrawBatch {
+    uint32_t meshIndex;
+    uint32_t lod;
+    // the batch's range of the visible instance list
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+// per frame input of cull.comp, pushed through the frame allocator
+struct CullData {
+    Frustum frustum;
+    uint32_t objectCount;
+};
+struct CullPushConstants {
+    VkDeviceAddress objectBufferAddress;
+    VkDeviceAddress instanceBufferAddress;
+    VkDeviceAddress drawCommandAddress;
+    VkDeviceAddress visibleInstanceAddress;
+    VkDeviceAddress cullDataAddress;
+};
+enum class DevicePolicy {
+    DiscreteOnly,
+    // picks the best available device type: discrete > integrated > virtual > CPU
+    PreferDiscrete
+};
+// procedurally generated stress scene used instead of the built-in quad and texture.jpg
+struct SyntheticScene {
+    uint32_t drawCount = 1;
+    uint32_t triangleCount = 2;
+    uint32_t textureCount = 1;
+    uint32_t textureSize = 256;
+};
+struct EngineConfig {
+    // renders into a ring of offscreen images without a window, surface or swapchain
+    bool headless = false;
+    bool validation = true;
+    uint32_t width = 800;
+    uint32_t height = 600;
+    DevicePolicy devicePolicy = DevicePolicy::PreferDiscrete;
+    // when set, animation advances by this many seconds per frame instead of following the wall clock
+    std::optional<float> fixedTimestep;
+    std::optional<SyntheticScene> syntheticScene;
+    // OBJ or glTF files loaded in parallel, they replace the synthetic scene and the built-in quad
+    std::vector<std::string> meshPaths;
+    // binary pack written by writeMeshPack, takes precedence over meshPaths
+    std::string meshPackPath;
+    // store imported meshes as PackedVertex, 16 instead of 32 bytes per vertex
+    bool quantizeVertices = false;
+    // cull instances in a compute pass that fills in the instance counts of indirect draws,
+    // falls back to CPU culling and vkCmdDrawIndexed without drawIndirectFirstInstance
+    bool gpuCulling = true;
+    // draw each instance at the coarsest level of detail whose error projects to at most
+    // lodErrorPixels on screen
+    bool lods = true;
+    float lodErrorPixels = 1.0f;
+    // full mip chains for textures, blitted on the graphics queue when the format supports linear
+    // filtering and built on the CPU with a box filter otherwise
+    bool mipmaps = true;
+    // when set, mip chains are always built on the CPU with this filter
+    std::optional<MipFilter> cpuMipFilter;
+    // KTX2 files loaded in place of texture.jpg and the synthetic scene's checkerboards
+    std::vector<std::string> texturePaths;
+};
+enum class FramePacing {
+    LowLatency,
+    Throughput
+};
+struct TimingStats {
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    uint64_t frames = 0;
+    void add(double ms) {
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+        frames++;
+    }
 };
+// triangles of the instances handed to culling, summed since startup
+struct LodStats {
+    uint64_t frames = 0;
+    uint64_t triangles = 0;
+    // the same instances at full detail
+    uint64_t fullDetailTriangles = 0;
+};
+struct PendingFrame {
+    uint64_t timelineValue;
+    std::chrono::high_resolution_clock::time_point submitTime;
+    FramePacing pacing;
+};
+// value of the transfer timeline that has to be acquired before the uploaded resource can be used
+struct UploadTicket {
+    uint64_t transferValue = 0;
+};
+// one transfer queue submit, acquired on the graphics queue once the transfer timeline passes it
+// an image whose level 0 was uploaded in TRANSFER_DST layout, the other levels are blitted from
+// it on the graphics queue when its batch is acquired
+struct MipBlit {
+    VkImage image;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+};
+struct UploadBatch {
+    VkCommandBuffer transferCmdBuffer;
+    uint64_t transferValue;
+    std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+    std::vector<VkImageMemoryBarrier2> imageBarriers;
+    std::vector<MipBlit> mipBlits;
+    VkCommandBuffer acquireCmdBuffer = VK_NULL_HANDLE;
+    // main timeline value of the acquire submit, 0 until it is submitted
+    uint64_t acquireValue = 0;
+};
+struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    Allocation memory;
+    UploadTicket ticket;
+    // element of the bindless texture array holding this texture's descriptor
+    uint32_t slot = 0;
+    uint32_t mipLevels = 1;
+};
+struct TextureStats {
+    uint64_t textures = 0;
+    uint64_t bytes = 0;
+    // of which the levels below level 0
+    uint64_t mipBytes = 0;
+    // the same levels stored as RGBA8, bytes/rgba8Bytes is what block compression saves
+    uint64_t rgba8Bytes = 0;
+    uint64_t blitTextures = 0;
+    uint64_t cpuTextures = 0;
+    double cpuMipMs = 0.0;
+    // KTX2 textures sampled in their block compressed format, and those decoded to RGBA8 because
+    // the device can't sample it
+    uint64_t compressedTextures = 0;
+    uint64_t decodedTextures = 0;
+    double decodeMs = 0.0;
+    // KTX2 files with zstd or zlib supercompressed levels, inflated on the thread pool
+    uint64_t supercompressedTextures = 0;
+    double inflateMs = 0.0;
+};
+struct Material {
+    glm::vec4 baseColor;
+    uint32_t textureIndex;
+};
+// a Material as render.frag sees it, rebuilt every frame into the frame allocator
+struct GpuMaterial {
+    float baseColor[4];
+    uint32_t textureSlot;
+};
+// model matrices are per instance, see GpuInstance
 struct MVP {
-    glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
 };
 
 struct Engine {
-    Engine();
+    Engine(EngineConfig engineConfig = EngineConfig{});
     ~Engine();
     void run();
+    void renderFrames(uint32_t frameCount);
+    void renderFrame();
+    void submitFrame(VkSemaphore waitSemaphore, VkSemaphore signalSemaphore);
     void recordCmdBuffer(VkCommandBuffer& cmdBuffer, uint32_t imageIndex);
+    void setFramePacing(FramePacing pacing);
+    void setFramesInFlight(uint32_t count);
+    void setMsaaSamples(VkSampleCountFlagBits samples);
+    void enableReadback(ReadbackCallback consumer);
+    void createReadbackBuffers();
+    void destroyReadbackBuffers();
+    void recordReadback(VkCommandBuffer& cmdBuffer);
+    void dispatchReadbacks();
+    // Streams a texture in and returns its index. It is sampled through its material once the upload
+    // completes, until then the material shows the fallback texture.
+    uint32_t loadTexture(const void* pixels, uint32_t width, uint32_t height);
+    // KTX2 file with its own mip chain, uploaded in its block compressed format when the device
+    // samples it and decoded to RGBA8 otherwise
+    uint32_t loadTexture(const std::string& path);
+    // materials using the texture fall back from the next frame on, its slot and memory are
+    // recycled once the frames already submitted and the one being recorded have completed, so
+    // it is safe to call between frames and during recording
+    void unloadTexture(uint32_t textureIndex);
+    void collectRetiredTextures();
 
     void createWindow();
     void createInstance();
@@ -42,30 +251,53 @@ struct Engine {
     void createSwapchain();
     void recreateSwapchain();
     void cleanupSwapchain();
-    void createImageView(VkImage& image, VkImageView& imageView, VkImageAspectFlags aspectMask, VkFormat format);
+    void createOffscreenTargets();
+    void createImageView(VkImage& image, VkImageView& imageView, VkImageAspectFlags aspectMask, VkFormat format, 
+        uint32_t mipLevels = 1);
     void createDescriptorSetLayout();
     void createDescriptorPool();
     void createDescriptorSets();
     void createGfxPipelineLayout();
     void createGfxPipeline();
+    void createCullPipeline();
     void createShaderModule(std::vector<char> code, VkShaderModule& shaderModule);
     void createCommandPool(VkCommandPool& cmdPool, uint32_t queueFamilyIndex);
     void createSemaphore(VkSemaphore& sem);
-    void createFence(VkFence& fence, VkFenceCreateFlags flags);
-    void createBuffer(VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, 
+    void createTimelineSemaphore(VkSemaphore& sem, uint64_t initialValue);
+    void createBuffer(VkBuffer& buffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, 
         VkMemoryPropertyFlags memProperties);
-    void createVertexBuffer();
-    void createIndexBuffer();
-    void createMVP();
+    void createVertexBuffer(const void* data, VkDeviceSize size);
+    void createIndexBuffer(const void* data, VkDeviceSize size);
+    void createGeometryBuffers();
     void createTextureImage();
-    void createTextureSampler();
-    void createImage(VkImage& image, VkDeviceMemory& imageMemory, VkFormat format, VkExtent3D extent, VkImageUsageFlags usage);
-    void createColorAttachment();
+    void createTexture(Texture& texture, const void* pixels, uint32_t width, uint32_t height);
+    // generateMips builds the rest of the chain from a single RGBA8 level, when config.mipmaps is set
+    void createTexture(Texture& texture, VkFormat format, const std::vector<TextureLevel>& levels, bool generateMips);
+    void destroyTexture(Texture& texture);
+    void createMaterials();
+    Mesh createSyntheticMesh();
+    void createMeshes();
+    void packMeshes(std::vector<Mesh>& meshes);
+    void createObjects();
+    void createIndirectBuffers();
+    void destroyIndirectBuffers();
+    void recordCull(VkCommandBuffer& cmdBuffer);
+    // one sampler per level count, so every texture's LOD range ends at its smallest level
+    VkSampler getTextureSampler(uint32_t mipLevels);
+    // optimal tiling images of the format can be uploaded to and sampled with linear filtering
+    bool supportsTextureFormat(VkFormat format);
+    // linear blits, for mip chains generated on the GPU
+    bool supportsMipBlits(VkFormat format);
+    void createImage(VkImage& image, Allocation& imageMemory, VkFormat format, VkExtent3D extent, VkImageUsageFlags usage,
+        VkSampleCountFlagBits samples, uint32_t mipLevels = 1);
+    void buildRenderGraph();
+    void recordScene(VkCommandBuffer& cmdBuffer, VkImageView colorView, VkImageView resolveView);
     void createDepthAttachment();
 
-    GLFWwindow* window;
+    EngineConfig config;
+    GLFWwindow* window = nullptr;
     VkInstance instance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkPhysicalDevice pDevice;
     VkDevice device;
     QueueFamilyIndices queueFamilyIndices;
@@ -77,41 +309,140 @@ struct Engine {
     VkFormat swapchainFormat;
     std::vector<VkImage> swapchainImages;
     std::vector<VkImageView> swapchainImageViews;
+    std::vector<Allocation> offscreenImageMemory;
+    // signaled by the frame rendering into the image with the same index and waited on by its present
+    std::vector<VkSemaphore> presentSemaphores;
     VkPipeline gfxPipeline;
     VkDescriptorSetLayout gfxDescriptorSetLayoutUniform;
-    VkDescriptorSetLayout gfxDescriptorSetLayoutSampler;
+    // one UPDATE_AFTER_BIND, PARTIALLY_BOUND array of textureSlots.capacity combined image samplers
+    VkDescriptorSetLayout gfxDescriptorSetLayoutTextures;
     VkDescriptorPool gfxDescriptorPool;
-    std::vector<VkDescriptorSet> gfxDescriptorSets;
-    VkDescriptorSet gfxDescriptorSetSampler;
+    // binds the frame allocator buffer as a dynamic uniform buffer, the offset picks the frame's MVP
+    VkDescriptorSet gfxDescriptorSet;
+    // bound once per frame, textures are picked through the material table
+    VkDescriptorSet gfxDescriptorSetTextures;
     VkPipelineLayout gfxPipelineLayout;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
     VkCommandPool gfxCmdPool;
-    VkCommandPool presentCmdPool;
     VkCommandPool transferCmdPool;
+    std::vector<VkCommandBuffer> gfxCmdBuffers;
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    Allocation vertexBufferMemory;
     VkDeviceSize vertexBufferSize;
     VkDeviceAddress vertexBufferAddress;
     VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    Allocation indexBufferMemory;
     VkDeviceSize indexBufferSize;
     PushConstants pushConstants;
-    std::vector<VkBuffer> MVPBuffers;
-    std::vector<VkDeviceMemory> MVPBufferMemory;
-    std::vector<void*> MVPBufferMemoryMapped;
-    VkImage textureImage;
-    VkImageView textureImageView;
-    VkDeviceMemory textureImageMemory;
-    VkSampler textureSampler;
+    uint32_t mvpOffset = 0;
+    VkDeviceAddress cullDataAddress = 0;
+    // one per instance, instance i takes its transform from the scene node instanceNodes[i]
+    std::vector<GpuObject> objects;
+    SceneGraph scene;
+    uint32_t sceneRoot;
+    std::vector<uint32_t> instanceNodes;
+    // level of detail of each instance, kept between frames for the hysteresis
+    std::vector<uint32_t> instanceLods;
+    std::vector<uint32_t> instanceMaterials;
+    LodStats lodStats;
+    // an instance switches level only once the error is this fraction past lodErrorPixels
+    static constexpr float LOD_HYSTERESIS = 0.25f;
+    // ordered by index type, mesh and level of detail
+    std::vector<DrawBatch> drawBatches;
+    // length of the visible instance list: every level's batch has room for all instances of its mesh
+    uint32_t visibleInstanceCapacity = 0;
+    VkBuffer objectBuffer;
+    Allocation objectBufferMemory;
+    // meshRanges as seen by the shaders
+    VkBuffer meshBuffer;
+    Allocation meshBufferMemory;
+    // enabled when requested and the device supports drawIndirectFirstInstance
+    bool gpuCulling = false;
+    // one per frame in flight: a command per batch followed by the visible instance list at
+    // visibleInstanceOffset, the commands are reset from drawCommandTemplate every frame
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<Allocation> indirectBufferMemory;
+    std::vector<VkDeviceAddress> indirectBufferAddresses;
+    VkDeviceSize visibleInstanceOffset = 0;
+    VkBuffer drawCommandTemplate = VK_NULL_HANDLE;
+    Allocation drawCommandTemplateMemory;
+    uint32_t graphIndirect;
+    // without GPU culling the instances are culled on the CPU before recording, see Culling.hpp
+    SphereBounds objectBounds;
+    std::vector<uint32_t> visibleObjects;
+    std::vector<uint32_t> visibleInstanceCounts;
+    // view depth of each batch's nearest visible instance, the depth of its draw packet
+    std::vector<float> batchDepths;
+    // rebuilt and sorted by updateInstances, replayed by recordScene
+    DrawList drawList;
+    DrawStats drawStats;
+    // a texture keeps its index for life, unloadTexture leaves an empty entry behind
+    std::vector<Texture> textures;
+    // 1x1 white in slot 0, drawn in place of textures still uploading or already unloaded
+    Texture fallbackTexture;
+    SlotAllocator textureSlots;
+    static constexpr uint32_t MAX_TEXTURE_SLOTS = 4096;
+    // unloaded textures wait here for the frames that may still sample them, with the timeline value to wait for
+    std::deque<std::pair<uint64_t, Texture>> retiredTextures;
+    std::vector<Material> materials;
+    std::map<uint32_t, VkSampler> textureSamplers;
+    TextureStats textureStats;
     VkImage depthImage;
     VkImageView depthImageView;
-    VkDeviceMemory depthImageMemory;
-    VkImage colorImage;
-    VkImageView colorImageView;
-    VkDeviceMemory colorImageMemory;
+    Allocation depthImageMemory;
+    // with msaaSamples > 1 the graph renders into a transient multisampled image resolved into the target
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    RenderGraph renderGraph;
+    uint32_t graphTarget;
+    uint32_t graphReadback;
+    // whether each frame in flight rendered through the MSAA resolve, picks its gpuTimeStats entry
+    std::vector<bool> gpuFrameMsaa;
+    // one persistently mapped host buffer per frame in flight receiving that frame's color target
+    bool readbackEnabled = false;
+    std::vector<VkBuffer> readbackBuffers;
+    std::vector<Allocation> readbackBufferMemory;
+    std::vector<std::optional<uint64_t>> readbackFrameNumbers;
+    ReadbackWorker readbackWorker;
+    Profiler profiler;
+    uint64_t frameNumber = 0;
+    double lastRecordMs = 0.0;
+    // every buffer and image is sub-allocated from here, see Allocator.hpp
+    MemoryAllocator allocator;
+    static constexpr VkDeviceSize ALLOCATOR_BLOCK_SIZE = 64ull*1024*1024;
+    // all uploads are staged in the ring and batched into uploadCmdBuffer on transferQueue until
+    // flushUploads, then handed over to the graphics queue by processUploads once they complete
+    StagingRing stagingRing;
+    static constexpr VkDeviceSize STAGING_RING_SIZE = 32ull*1024*1024;
+    // larger uploads are split so a single asset can't hold the whole ring
+    static constexpr VkDeviceSize STAGING_CHUNK_SIZE = 8ull*1024*1024;
+    // uniform and per-draw data of the frame being recorded, see FrameAllocator.hpp
+    FrameAllocator frameAllocator;
+    // room for the instance data and visible lists of ~200k instances
+    static constexpr VkDeviceSize FRAME_ALLOCATOR_SLICE_SIZE = 16ull*1024*1024;
+    VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+    // release barriers for the batch being recorded, doubling as the acquire barriers
+    std::vector<VkBufferMemoryBarrier2> uploadBufferBarriers;
+    std::vector<VkImageMemoryBarrier2> uploadImageBarriers;
+    std::vector<MipBlit> uploadMipBlits;
+    std::deque<UploadBatch> uploadBatches;
+    VkSemaphore transferTimeline;
+    uint64_t transferTimelineValue = 0;
+    uint64_t acquiredTransferValue = 0;
+    UploadTicket geometryTicket;
+    // device-wide timeline: every frame and every upload submit signals the next value
+    VkSemaphore timeline;
+    uint64_t timelineValue = 0;
+    std::vector<uint64_t> frameTimelineValues;
+    FramePacing framePacing = FramePacing::Throughput;
+    std::deque<PendingFrame> pendingFrames;
+    TimingStats latencyStats[2];
+    // GPU time per frame, [0] rendering straight into the swapchain image, [1] through the MSAA resolve
+    TimingStats gpuTimeStats[2];
 
-    const uint32_t WIDTH = 800;
-    const uint32_t HEIGHT = 600;
     const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+    const uint32_t LOW_LATENCY_FRAMES_IN_FLIGHT = 1;
+    uint32_t framesInFlight = MAX_FRAMES_IN_FLIGHT;
     uint32_t currFrame = 0;
     std::vector<const char*> instanceLayers = {
         "VK_LAYER_KHRONOS_validation"
@@ -123,32 +454,62 @@ struct Engine {
     std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
-    const std::vector<Vertex> vertices = {
-        {-0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f},
-        {0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f},
-        {0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f},
-        {-0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}
-    };
-    const std::vector<uint32_t> indices = {
-        0, 1, 2, 2, 3, 0
-    };
+    // every mesh packed into one vertex and one index buffer in its own format, draw i uses meshRanges[i%size]
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    std::vector<MeshRange> meshRanges;
+    // mapped from createMeshes until its blobs are staged by createGeometryBuffers
+    MeshPack meshPack;
+    ThreadPool threadPool;
+    MeshLoadStats meshLoadStats;
 
     bool checkInstanceLayersSupport();
     bool checkInstanceExtensionsSupport();
     bool checkDeviceExtensionsSupport(VkPhysicalDevice dev);
     bool isDeviceSuitable(VkPhysicalDevice dev);
+    int getDeviceScore(VkPhysicalDevice dev);
     QueueFamilyIndices getQueueFamilyIndices(VkPhysicalDevice dev);
     SurfaceDetails getSurfaceDetails(VkPhysicalDevice dev);
     VkExtent2D chooseSurfaceExtent(VkSurfaceCapabilitiesKHR capabilities);
     VkPresentModeKHR choosePresentMode(std::vector<VkPresentModeKHR> modes);
     VkSurfaceFormatKHR chooseSurfaceFormat(std::vector<VkSurfaceFormatKHR> formats);
     VkCommandBuffer allocateCommandBuffer(VkCommandPool& cmdPool);
-    uint32_t getMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags memProperties);
-    void copyBuffer(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size);
-    void copyBufferToImage(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkImage& dstImage, uint32_t width, uint32_t height);
-    void updateMVP(uint32_t currFrame);
+    std::optional<uint32_t> findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags memProperties);
+    VkDeviceAddress getBufferAddress(VkBuffer& buffer);
+    void copyBuffer(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkDeviceSize srcOffset, VkBuffer& dstBuffer, 
+        VkDeviceSize dstOffset, VkDeviceSize size);
+    void copyBufferToImage(VkCommandBuffer& cmdBuffer, VkBuffer& srcBuffer, VkDeviceSize srcOffset, VkImage& dstImage, 
+        uint32_t width, uint32_t y, uint32_t rows, uint32_t mipLevel = 0);
+    UploadTicket uploadBuffer(VkBuffer& dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // uploads the given levels and fills in the rest of mipLevels below them, by blits after the
+    // acquire or from the CPU; only a single RGBA8 level can have levels filled in
+    UploadTicket uploadImage(VkImage& image, VkFormat format, const std::vector<TextureLevel>& levels, uint32_t mipLevels);
+    void uploadImageLevel(VkImage& image, const TextureFormatInfo& info, const TextureLevel& level, uint32_t mipLevel);
+    bool isUploadReady(UploadTicket ticket);
+    void waitUploads();
+    StagingRegion stageUpload(VkDeviceSize size);
+    VkCommandBuffer getUploadCmdBuffer();
+    void flushUploads();
+    void processUploads();
+    void acquireUploads(UploadBatch& batch);
+    void recordMipBlits(VkCommandBuffer& cmdBuffer, const MipBlit& blit);
+    void copyImageToBuffer(VkCommandBuffer& cmdBuffer, VkImage& srcImage, VkBuffer& dstBuffer, uint32_t width, uint32_t height);
+    void updateMVP();
+    void updateInstances(const MVP& mvp);
+    void updateMaterials();
+    void buildDrawList();
     VkCommandBuffer beginSingleCommandRecording(VkCommandPool& cmdPool);
-    void endSingleCommandRecording(VkCommandBuffer& cmdBuffer, VkQueue& queue);
-    void transitionImageLayout(VkImage& image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer& cmdBuffer);
-    void copyImage(VkCommandBuffer& cmdBuffer, VkImage& srcImage, VkImage& dstImage, VkExtent3D extent);
+    void submitWithTimeline(VkCommandBuffer cmdBuffer, VkQueue& queue, VkSemaphore waitSemaphore, uint64_t waitValue,
+        VkSemaphore signalSemaphore, uint64_t signalValue);
+    uint64_t getCompletedTimelineValue();
+    uint64_t getCompletedTimelineValue(VkSemaphore semaphore);
+    void waitTimeline(uint64_t value);
+    void waitTimeline(VkSemaphore semaphore, uint64_t value);
+    void collectFrameLatency();
+    void printFrameReport();
+    void collectGpuTime(uint32_t frame);
+    VkSampleCountFlagBits getMaxMsaaSamples(VkSampleCountFlagBits limit);
+    void transitionImageLayout(VkImage& image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer& cmdBuffer,
+        VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, uint32_t baseMipLevel = 0, 
+        uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
 };
\ No newline at end of file
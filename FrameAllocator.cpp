@@ -0,0 +1,49 @@
+#include "FrameAllocator.hpp"
+
+void FrameAllocator::init(VkDevice dev, VkPhysicalDevice pDev, MemoryAllocator& allocator, VkDeviceSize sliceBytes, 
+    uint32_t sliceCount) {
+    device = dev;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(pDev, &props);
+    alignment = std::max(props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment);
+    sliceSize = (sliceBytes + alignment - 1)/alignment*alignment;
+    VkBufferCreateInfo bufferCI{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .size = sliceSize*sliceCount,
+        .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr
+    };
+    VK_CHECK(vkCreateBuffer(device, &bufferCI, nullptr, &buffer));
+    memory = allocator.allocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    VkBufferDeviceAddressInfo bdaInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = nullptr,
+        .buffer = buffer
+    };
+    baseAddress = vkGetBufferDeviceAddress(device, &bdaInfo);
+}
+void FrameAllocator::destroy(MemoryAllocator& allocator) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator.free(memory);
+}
+void FrameAllocator::beginFrame(uint32_t slice) {
+    sliceStart = slice*sliceSize;
+    head = sliceStart;
+}
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size) {
+    VkDeviceSize offset = (head + alignment - 1)/alignment*alignment;
+    if (offset + size > sliceStart + sliceSize) {
+        throw std::runtime_error("VK Error: per-frame data does not fit into the frame allocator slice");
+    }
+    head = offset + size;
+    peakBytes = std::max(peakBytes, head - sliceStart);
+    return FrameAllocation{
+        .offset = offset,
+        .data = static_cast<char*>(memory.mapped) + offset,
+        .address = baseAddress + offset
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+#include "Allocator.hpp"
+
+struct FrameAllocation {
+    VkDeviceSize offset;
+    void* data;
+    VkDeviceAddress address;
+};
+
+// One persistently mapped buffer split into a slice per frame in flight. Per-frame data is
+// bump allocated from the current slice and addressed through a dynamic offset or its device
+// address; beginFrame() recycles a slice once the frame that used it has completed.
+struct FrameAllocator {
+    void init(VkDevice dev, VkPhysicalDevice pDev, MemoryAllocator& allocator, VkDeviceSize sliceBytes, uint32_t sliceCount);
+    void destroy(MemoryAllocator& allocator);
+    void beginFrame(uint32_t slice);
+    FrameAllocation allocate(VkDeviceSize size);
+    template<typename T>
+    FrameAllocation push(const T& value) {
+        FrameAllocation allocation = allocate(sizeof(T));
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation memory;
+    VkDeviceAddress baseAddress = 0;
+    VkDeviceSize sliceSize = 0;
+    // satisfies both the uniform and the storage buffer dynamic offset rules
+    VkDeviceSize alignment = 0;
+    VkDeviceSize sliceStart = 0;
+    VkDeviceSize head = 0;
+    VkDeviceSize peakBytes = 0;
+};
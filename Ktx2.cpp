@@ -0,0 +1,330 @@
+#include "Ktx2.hpp"
+#include "Mipmaps.hpp"
+#include <zlib.h>
+#include <zstd.h>
+
+namespace {
+
+constexpr uint8_t KTX2_IDENTIFIER[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// RGB565 endpoints expanded to 8 bits the way the hardware does, by replicating the high bits
+void decodeColor565(uint16_t color, uint8_t out[4]) {
+    uint32_t r = (color >> 11) & 31;
+    uint32_t g = (color >> 5) & 63;
+    uint32_t b = color & 31;
+    out[0] = (uint8_t)((r << 3) | (r >> 2));
+    out[1] = (uint8_t)((g << 2) | (g >> 4));
+    out[2] = (uint8_t)((b << 3) | (b >> 2));
+    out[3] = 255;
+}
+// the 16 texels of a color block in row order; BC3 color blocks always use the 4 color mode
+void decodeBc1Block(const uint8_t* block, uint8_t rgba[16][4], bool forceFourColors) {
+    uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+    uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+    uint8_t palette[4][4];
+    decodeColor565(c0, palette[0]);
+    decodeColor565(c1, palette[1]);
+    for (int c=0; c<3; c++) {
+        if (c0 > c1 || forceFourColors) {
+            palette[2][c] = (uint8_t)((2*palette[0][c] + palette[1][c] + 1)/3);
+            palette[3][c] = (uint8_t)((palette[0][c] + 2*palette[1][c] + 1)/3);
+        } else {
+            palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c] + 1)/2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    // the fourth entry of the 3 color mode is transparent black
+    palette[3][3] = (c0 > c1 || forceFourColors) ? 255 : 0;
+    uint32_t indices = (uint32_t)(block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24));
+    for (int i=0; i<16; i++) {
+        memcpy(rgba[i], palette[(indices >> (2*i)) & 3], 4);
+    }
+}
+// BC4 is also the alpha block of BC3 and each channel of BC5
+void decodeBc4Block(const uint8_t* block, uint8_t values[16]) {
+    uint32_t v0 = block[0];
+    uint32_t v1 = block[1];
+    uint8_t palette[8];
+    palette[0] = (uint8_t)v0;
+    palette[1] = (uint8_t)v1;
+    if (v0 > v1) {
+        for (uint32_t i=1; i<7; i++) {
+            palette[i+1] = (uint8_t)(((7-i)*v0 + i*v1 + 3)/7);
+        }
+    } else {
+        for (uint32_t i=1; i<5; i++) {
+            palette[i+1] = (uint8_t)(((5-i)*v0 + i*v1 + 2)/5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int i=0; i<6; i++) {
+        indices |= (uint64_t)block[2+i] << (8*i);
+    }
+    for (int i=0; i<16; i++) {
+        values[i] = palette[(indices >> (3*i)) & 7];
+    }
+}
+
+}
+
+std::optional<TextureFormatInfo> getTextureFormatInfo(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return TextureFormatInfo{1, 1, 4};
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        return TextureFormatInfo{4, 4, 8};
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return TextureFormatInfo{4, 4, 16};
+    case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+        return TextureFormatInfo{5, 5, 16};
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+        return TextureFormatInfo{6, 6, 16};
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+        return TextureFormatInfo{8, 8, 16};
+    default:
+        return std::nullopt;
+    }
+}
+VkDeviceSize getTextureLevelSize(const TextureFormatInfo& info, uint32_t width, uint32_t height) {
+    VkDeviceSize blocksWide = (width + info.blockWidth - 1)/info.blockWidth;
+    VkDeviceSize blocksHigh = (height + info.blockHeight - 1)/info.blockHeight;
+    return blocksWide*blocksHigh*info.blockBytes;
+}
+
+void Ktx2File::open(const std::string& filePath) {
+    path = filePath;
+    file.open(path);
+    const Ktx2Header* header = reinterpret_cast<const Ktx2Header*>(file.data);
+    if (file.size < sizeof(Ktx2Header) || memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        close();
+        throw std::runtime_error("VK Error: not a KTX2 file " + path);
+    }
+    // VK_FORMAT_UNDEFINED is Basis Universal, which needs a transcoder to become a GPU format
+    // the header is read before close() unmaps it
+    std::optional<TextureFormatInfo> info = getTextureFormatInfo((VkFormat)header->vkFormat);
+    if (!info.has_value()) {
+        VkFormat headerFormat = (VkFormat)header->vkFormat;
+        close();
+        throw std::runtime_error("VK Error: unsupported KTX2 format " + std::string(string_VkFormat(headerFormat))
+            + " in " + path);
+    }
+    if (header->pixelWidth == 0 || header->pixelHeight == 0 || header->pixelDepth > 1 || header->layerCount > 1 ||
+        header->faceCount != 1) {
+        close();
+        throw std::runtime_error("VK Error: only single 2D images are supported, " + path);
+    }
+    if (header->supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE && header->supercompressionScheme != KTX2_SUPERCOMPRESSION_ZSTD &&
+        header->supercompressionScheme != KTX2_SUPERCOMPRESSION_ZLIB) {
+        uint32_t scheme = header->supercompressionScheme;
+        close();
+        throw std::runtime_error("VK Error: unsupported KTX2 supercompression scheme " + std::to_string(scheme) + " in " + path);
+    }
+    format = (VkFormat)header->vkFormat;
+    width = header->pixelWidth;
+    height = header->pixelHeight;
+    supercompression = header->supercompressionScheme;
+    generateMips = header->levelCount == 0;
+    uint32_t levelCount = std::max(header->levelCount, 1u);
+    const Ktx2LevelIndex* index = reinterpret_cast<const Ktx2LevelIndex*>(file.data + sizeof(Ktx2Header));
+    // more levels than the chain down to 1x1 has would make an invalid image
+    if (levelCount > getMipLevelCount(width, height) || sizeof(Ktx2Header) + levelCount*sizeof(Ktx2LevelIndex) > file.size) {
+        close();
+        throw std::runtime_error("VK Error: corrupt KTX2 file " + path);
+    }
+    levels.clear();
+    for (uint32_t level=0; level<levelCount; level++) {
+        TextureLevel textureLevel{
+            .width = std::max(width >> level, 1u),
+            .height = std::max(height >> level, 1u),
+            .data = file.data + index[level].byteOffset,
+            .size = index[level].byteLength
+        };
+        // a plain level holds at least the whole level; a supercompressed one has to declare the
+        // level's size as its uncompressedByteLength, which inflate() checks again
+        bool truncated = !file.contains(index[level].byteOffset, index[level].byteLength);
+        VkDeviceSize levelSize = getTextureLevelSize(info.value(), textureLevel.width, textureLevel.height);
+        if (supercompression == KTX2_SUPERCOMPRESSION_NONE) {
+            truncated = truncated || textureLevel.size < levelSize;
+        } else {
+            truncated = truncated || index[level].uncompressedByteLength != levelSize;
+        }
+        if (truncated) {
+            close();
+            throw std::runtime_error("VK Error: corrupt KTX2 file " + path);
+        }
+        levels.push_back(textureLevel);
+    }
+}
+void Ktx2File::close() {
+    file.close();
+    levels.clear();
+    inflatedLevels.clear();
+}
+void Ktx2File::inflate(ThreadPool* pool) {
+    if (supercompression == KTX2_SUPERCOMPRESSION_NONE) {
+        return;
+    }
+    TextureFormatInfo info = getTextureFormatInfo(format).value();
+    inflatedLevels.resize(levels.size());
+    auto inflateLevel = [&](size_t level) {
+        const TextureLevel& compressed = levels[level];
+        std::vector<uint8_t>& out = inflatedLevels[level];
+        out.resize(getTextureLevelSize(info, compressed.width, compressed.height));
+        bool inflated;
+        if (supercompression == KTX2_SUPERCOMPRESSION_ZSTD) {
+            size_t written = ZSTD_decompress(out.data(), out.size(), compressed.data, compressed.size);
+            inflated = !ZSTD_isError(written) && written == out.size();
+        } else {
+            uLongf written = (uLongf)out.size();
+            inflated = uncompress(out.data(), &written, compressed.data, (uLong)compressed.size) == Z_OK && written == out.size();
+        }
+        if (!inflated) {
+            throw std::runtime_error("VK Error: cannot inflate level " + std::to_string(level) + " of " + path);
+        }
+    };
+    // the top level is most of the data, so the pool mostly overlaps it with the rest of the chain
+    if (pool == nullptr) {
+        for (size_t level=0; level<levels.size(); level++) {
+            inflateLevel(level);
+        }
+    } else {
+        for (size_t level=0; level<levels.size(); level++) {
+            pool->submit([&inflateLevel, level] { inflateLevel(level); });
+        }
+        pool->wait();
+    }
+    for (size_t level=0; level<levels.size(); level++) {
+        levels[level].data = inflatedLevels[level].data();
+        levels[level].size = inflatedLevels[level].size();
+    }
+    supercompression = KTX2_SUPERCOMPRESSION_NONE;
+}
+
+bool canDecodeToRgba8(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return true;
+    default:
+        return false;
+    }
+}
+VkFormat getDecodedFormat(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    default:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+void decodeToRgba8(VkFormat format, const TextureLevel& level, uint8_t* dst, ThreadPool* pool) {
+    TextureFormatInfo info = getTextureFormatInfo(format).value();
+    uint32_t blocksWide = (level.width + 3)/4;
+    uint32_t blocksHigh = (level.height + 3)/4;
+    bool rgbOnly = format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    auto job = [&](size_t begin, size_t end) {
+        uint8_t rgba[16][4];
+        for (size_t by=begin; by<end; by++) {
+            for (uint32_t bx=0; bx<blocksWide; bx++) {
+                const uint8_t* block = level.data + ((size_t)by*blocksWide + bx)*info.blockBytes;
+                switch (format) {
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK: {
+                    uint8_t alpha[16];
+                    decodeBc4Block(block, alpha);
+                    decodeBc1Block(block + 8, rgba, true);
+                    for (int i=0; i<16; i++) {
+                        rgba[i][3] = alpha[i];
+                    }
+                    break;
+                }
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK: {
+                    uint8_t red[16];
+                    uint8_t green[16] = {};
+                    decodeBc4Block(block, red);
+                    if (format == VK_FORMAT_BC5_UNORM_BLOCK) {
+                        decodeBc4Block(block + 8, green);
+                    }
+                    for (int i=0; i<16; i++) {
+                        rgba[i][0] = red[i];
+                        rgba[i][1] = green[i];
+                        rgba[i][2] = 0;
+                        rgba[i][3] = 255;
+                    }
+                    break;
+                }
+                default:
+                    decodeBc1Block(block, rgba, false);
+                    if (rgbOnly) {
+                        for (int i=0; i<16; i++) {
+                            rgba[i][3] = 255;
+                        }
+                    }
+                    break;
+                }
+                // blocks hang over the right and bottom edges of levels that aren't multiples of 4
+                for (uint32_t y=0; y<4 && by*4+y<level.height; y++) {
+                    uint32_t columns = std::min(4u, level.width - bx*4);
+                    memcpy(dst + ((by*4+y)*level.width + bx*4)*4, rgba[y*4], columns*4);
+                }
+            }
+        }
+    };
+    if (pool == nullptr) {
+        job(0, blocksHigh);
+        return;
+    }
+    pool->parallelFor(blocksHigh, 16, job);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "config.hpp"
+#include "ThreadPool.hpp"
+#include "MeshPack.hpp"
+
+// KTX2 textures: the container is mapped and its levels are uploaded straight from the mapping
+// when the device samples the format, otherwise decoded to RGBA8 on a ThreadPool first. zstd and
+// zlib supercompressed levels are inflated on the pool before either.
+
+// texel blocks of the formats textures may use, 1x1 blocks for the uncompressed ones
+struct TextureFormatInfo {
+    uint32_t blockWidth;
+    uint32_t blockHeight;
+    uint32_t blockBytes;
+};
+// RGBA8, BC1/3/4/5/7 and ASTC 4x4 to 8x8, nullopt for anything else
+std::optional<TextureFormatInfo> getTextureFormatInfo(VkFormat format);
+// bytes of one level, whole blocks at the edges
+VkDeviceSize getTextureLevelSize(const TextureFormatInfo& info, uint32_t width, uint32_t height);
+
+// one mip level, tightly packed blocks in row order
+struct TextureLevel {
+    uint32_t width;
+    uint32_t height;
+    const uint8_t* data;
+    VkDeviceSize size;
+};
+
+// supercompressionScheme values of the KTX2 spec
+constexpr uint32_t KTX2_SUPERCOMPRESSION_NONE = 0;
+constexpr uint32_t KTX2_SUPERCOMPRESSION_BASISLZ = 1;
+constexpr uint32_t KTX2_SUPERCOMPRESSION_ZSTD = 2;
+constexpr uint32_t KTX2_SUPERCOMPRESSION_ZLIB = 3;
+
+// single 2D image, no array layers, cube faces or depth; levels point into the mapping, or into
+// the inflated buffers after inflate(), and stay valid until close()
+struct Ktx2File {
+    void open(const std::string& filePath);
+    void close();
+    // inflates zstd and zlib levels, one pool job per level; afterwards the levels point at the
+    // inflated data and supercompression is NONE
+    void inflate(ThreadPool* pool = nullptr);
+
+    MappedFile file;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // NONE, ZSTD or ZLIB, BasisLZ would need a transcoder
+    uint32_t supercompression = KTX2_SUPERCOMPRESSION_NONE;
+    // level 0 first; a file with levelCount 0 asks the loader to generate the chain, it has one level here
+    std::vector<TextureLevel> levels;
+    bool generateMips = false;
+    std::string path;
+    std::vector<std::vector<uint8_t>> inflatedLevels;
+};
+
+// formats decodeToRgba8 handles, and the RGBA8 format with the same color space
+bool canDecodeToRgba8(VkFormat format);
+VkFormat getDecodedFormat(VkFormat format);
+// BC1, BC3, BC4 and BC5 to RGBA8, block rows split across the pool; BC4 and BC5 fill in the
+// missing channels with 0 and alpha with 255
+void decodeToRgba8(VkFormat format, const TextureLevel& level, uint8_t* dst, ThreadPool* pool = nullptr);
@@ -0,0 +1,744 @@
+#include "MeshLoader.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+
+namespace {
+
+struct VertexHash {
+    size_t operator()(const Vertex& vertex) const {
+        // FNV-1a over the raw floats, equal vertices are bitwise equal
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&vertex);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i=0; i<sizeof(Vertex); i++) {
+            hash = (hash ^ bytes[i])*1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+struct VertexEqual {
+    bool operator()(const Vertex& a, const Vertex& b) const {
+        return memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+struct VertexDeduplicator {
+    Mesh& mesh;
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> indexOf;
+
+    void add(const Vertex& vertex) {
+        auto [it, inserted] = indexOf.try_emplace(vertex, (uint32_t)mesh.vertices.size());
+        if (inserted) {
+            mesh.vertices.push_back(vertex);
+        }
+        mesh.indices.push_back(it->second);
+    }
+};
+
+void finishMesh(Mesh& mesh, MeshLoadStats& stats) {
+    stats.fileCount++;
+    stats.triangles += mesh.indices.size()/3;
+    stats.inputVertices += mesh.indices.size();
+    stats.uniqueVertices += mesh.vertices.size();
+}
+
+struct JsonValue {
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    // array elements, or object values with their keys in `keys`
+    std::vector<JsonValue> items;
+    std::vector<std::string> keys;
+
+    const JsonValue* find(const char* key) const {
+        for (size_t i=0; i<keys.size(); i++) {
+            if (keys[i] == key) {
+                return &items[i];
+            }
+        }
+        return nullptr;
+    }
+    const JsonValue& operator[](const char* key) const {
+        const JsonValue* value = find(key);
+        if (value == nullptr) {
+            throw std::runtime_error(std::string("VK Error: glTF is missing \"") + key + "\"");
+        }
+        return *value;
+    }
+    const JsonValue& operator[](size_t index) const {
+        if (index >= items.size()) {
+            throw std::runtime_error("VK Error: glTF index out of range");
+        }
+        return items[index];
+    }
+    uint32_t getUint(const char* key, uint32_t fallback) const {
+        const JsonValue* value = find(key);
+        return value != nullptr ? (uint32_t)value->number : fallback;
+    }
+};
+// just enough JSON for glTF: no validation beyond what is needed to not run off the end
+struct JsonParser {
+    const char* p;
+    const char* end;
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+    }
+    void expect(char c) {
+        skipSpace();
+        if (p >= end || *p != c) {
+            throw std::runtime_error(std::string("VK Error: glTF JSON expected '") + c + "'");
+        }
+        p++;
+    }
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (p < end && *p != '"') {
+            if (*p != '\\') {
+                out.push_back(*p++);
+                continue;
+            }
+            if (++p >= end) {
+                break;
+            }
+            char escape = *p++;
+            switch (escape) {
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    if (end - p < 4) {
+                        throw std::runtime_error("VK Error: glTF JSON truncated escape");
+                    }
+                    uint32_t code = (uint32_t)std::stoul(std::string(p, 4), nullptr, 16);
+                    p += 4;
+                    // surrogate pairs are left as two code points, names and uris are ASCII in practice
+                    if (code < 0x80) {
+                        out.push_back((char)code);
+                    } else if (code < 0x800) {
+                        out.push_back((char)(0xc0 | (code >> 6)));
+                        out.push_back((char)(0x80 | (code & 0x3f)));
+                    } else {
+                        out.push_back((char)(0xe0 | (code >> 12)));
+                        out.push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+                        out.push_back((char)(0x80 | (code & 0x3f)));
+                    }
+                    break;
+                }
+                default: out.push_back(escape); break;
+            }
+        }
+        expect('"');
+        return out;
+    }
+    JsonValue parse() {
+        skipSpace();
+        if (p >= end) {
+            throw std::runtime_error("VK Error: glTF JSON truncated");
+        }
+        JsonValue value;
+        if (*p == '{') {
+            value.type = JsonValue::Type::Object;
+            p++;
+            skipSpace();
+            if (p < end && *p == '}') {
+                p++;
+                return value;
+            }
+            while (true) {
+                value.keys.push_back(parseString());
+                expect(':');
+                value.items.push_back(parse());
+                skipSpace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                expect('}');
+                return value;
+            }
+        }
+        if (*p == '[') {
+            value.type = JsonValue::Type::Array;
+            p++;
+            skipSpace();
+            if (p < end && *p == ']') {
+                p++;
+                return value;
+            }
+            while (true) {
+                value.items.push_back(parse());
+                skipSpace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                expect(']');
+                return value;
+            }
+        }
+        if (*p == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+            return value;
+        }
+        if (end - p >= 4 && strncmp(p, "true", 4) == 0) {
+            value.type = JsonValue::Type::Bool;
+            value.boolean = true;
+            p += 4;
+            return value;
+        }
+        if (end - p >= 5 && strncmp(p, "false", 5) == 0) {
+            value.type = JsonValue::Type::Bool;
+            p += 5;
+            return value;
+        }
+        if (end - p >= 4 && strncmp(p, "null", 4) == 0) {
+            p += 4;
+            return value;
+        }
+        // the chunk is copied into a null terminated string, so strtod can't read past it
+        char* next;
+        value.type = JsonValue::Type::Number;
+        value.number = strtod(p, &next);
+        if (next == p) {
+            throw std::runtime_error("VK Error: glTF JSON unexpected character");
+        }
+        p = next;
+        return value;
+    }
+};
+
+std::vector<char> decodeBase64(const std::string& text) {
+    std::vector<char> out;
+    out.reserve(text.size()*3/4);
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (char c: text) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else continue;
+        bits = (bits << 6) | (uint32_t)v;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            out.push_back((char)((bits >> bitCount) & 0xff));
+        }
+    }
+    return out;
+}
+
+struct AccessorView {
+    const uint8_t* data;
+    uint32_t count;
+    uint32_t stride;
+    uint32_t componentType;
+    uint32_t components;
+    bool normalized;
+
+    float readFloat(uint32_t element, uint32_t component) const {
+        const uint8_t* src = data + (size_t)element*stride;
+        switch (componentType) {
+            case 5126: {
+                float v;
+                memcpy(&v, src + component*4, 4);
+                return v;
+            }
+            case 5121: return normalized ? src[component]/255.0f : src[component];
+            case 5120: {
+                float v = (float)(int8_t)src[component];
+                return normalized ? std::max(v/127.0f, -1.0f) : v;
+            }
+            case 5123: {
+                uint16_t v;
+                memcpy(&v, src + component*2, 2);
+                return normalized ? v/65535.0f : v;
+            }
+            case 5122: {
+                int16_t v;
+                memcpy(&v, src + component*2, 2);
+                return normalized ? std::max(v/32767.0f, -1.0f) : v;
+            }
+        }
+        throw std::runtime_error("VK Error: glTF unsupported vertex component type");
+    }
+    uint32_t readIndex(uint32_t element) const {
+        const uint8_t* src = data + (size_t)element*stride;
+        switch (componentType) {
+            case 5121: return src[0];
+            case 5123: {
+                uint16_t v;
+                memcpy(&v, src, 2);
+                return v;
+            }
+            case 5125: {
+                uint32_t v;
+                memcpy(&v, src, 4);
+                return v;
+            }
+        }
+        throw std::runtime_error("VK Error: glTF unsupported index component type");
+    }
+};
+
+AccessorView getAccessor(const JsonValue& gltf, const std::vector<std::vector<char>>& buffers, uint32_t index) {
+    const JsonValue& accessor = gltf["accessors"][index];
+    // sparse accessors and accessors without a buffer view (all zeros) aren't produced by the
+    // exporters we ingest from
+    const JsonValue& bufferView = gltf["bufferViews"][accessor.getUint("bufferView", UINT32_MAX)];
+    const std::vector<char>& buffer = buffers.at(bufferView.getUint("buffer", 0));
+    const std::string& type = accessor["type"].string;
+    uint32_t components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+    if (components == 0) {
+        throw std::runtime_error("VK Error: glTF unsupported accessor type " + type);
+    }
+    uint32_t componentType = accessor.getUint("componentType", 0);
+    uint32_t componentSize = componentType == 5126 || componentType == 5125 ? 4 : componentType == 5123 || componentType == 5122 ? 2 : 1;
+    AccessorView view{
+        .data = nullptr,
+        .count = accessor.getUint("count", 0),
+        .stride = bufferView.getUint("byteStride", components*componentSize),
+        .componentType = componentType,
+        .components = components,
+        .normalized = accessor.find("normalized") != nullptr && accessor["normalized"].boolean
+    };
+    size_t offset = (size_t)bufferView.getUint("byteOffset", 0) + accessor.getUint("byteOffset", 0);
+    if (view.count > 0 && offset + (size_t)view.stride*(view.count-1) + components*componentSize > buffer.size()) {
+        throw std::runtime_error("VK Error: glTF accessor out of buffer bounds");
+    }
+    view.data = reinterpret_cast<const uint8_t*>(buffer.data()) + offset;
+    return view;
+}
+
+}
+
+Mesh loadObj(const std::string& path, MeshLoadStats& stats) {
+    std::vector<char> data = readFile(path);
+    stats.bytes += data.size();
+    data.push_back('\0');
+    Mesh mesh;
+    mesh.name = path;
+    VertexDeduplicator deduplicator{.mesh = mesh, .indexOf = {}};
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> uvs;
+    std::vector<Vertex> polygon;
+
+    const char* p = data.data();
+    const char* end = data.data() + data.size() - 1;
+    auto skipSpace = [&] {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+    };
+    // strtof would skip the newline and read a short line's missing components from the next one,
+    // so parsing stops at the end of the line and they default to 0
+    auto parseFloats = [&](std::vector<float>& out, int count) {
+        for (int i=0; i<count; i++) {
+            skipSpace();
+            if (*p == '\n' || *p == '\r' || *p == '\0' || *p == '#') {
+                out.push_back(0.0f);
+                continue;
+            }
+            char* next;
+            out.push_back(strtof(p, &next));
+            p = next;
+        }
+    };
+    // 1-based, negative counts back from the last element parsed so far
+    auto resolve = [](long index, size_t count) -> size_t {
+        size_t resolved = index > 0 ? (size_t)(index - 1) : count + index;
+        if (index == 0 || resolved >= count) {
+            throw std::runtime_error("VK Error: OBJ face index out of range");
+        }
+        return resolved;
+    };
+    while (p < end) {
+        skipSpace();
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            parseFloats(positions, 3);
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            p += 2;
+            parseFloats(normals, 3);
+        } else if (p[0] == 'v' && p[1] == 't') {
+            p += 2;
+            parseFloats(uvs, 2);
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            polygon.clear();
+            while (true) {
+                skipSpace();
+                if (*p == '\n' || *p == '\r' || *p == '\0' || *p == '#') {
+                    break;
+                }
+                char* next;
+                long v = strtol(p, &next, 10);
+                if (next == p) {
+                    throw std::runtime_error("VK Error: OBJ malformed face in " + path);
+                }
+                p = next;
+                long vt = 0;
+                long vn = 0;
+                if (*p == '/') {
+                    p++;
+                    if (*p != '/') {
+                        vt = strtol(p, &next, 10);
+                        p = next;
+                    }
+                    if (*p == '/') {
+                        p++;
+                        vn = strtol(p, &next, 10);
+                        p = next;
+                    }
+                }
+                size_t pi = resolve(v, positions.size()/3);
+                Vertex vertex{positions[pi*3], positions[pi*3+1], positions[pi*3+2], 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+                if (vn != 0) {
+                    size_t ni = resolve(vn, normals.size()/3);
+                    vertex.nx = normals[ni*3];
+                    vertex.ny = normals[ni*3+1];
+                    vertex.nz = normals[ni*3+2];
+                }
+                if (vt != 0) {
+                    // OBJ puts the uv origin at the bottom left
+                    size_t ti = resolve(vt, uvs.size()/2);
+                    vertex.u = uvs[ti*2];
+                    vertex.v = 1.0f - uvs[ti*2+1];
+                }
+                polygon.push_back(vertex);
+            }
+            for (size_t i=2; i<polygon.size(); i++) {
+                deduplicator.add(polygon[0]);
+                deduplicator.add(polygon[i-1]);
+                deduplicator.add(polygon[i]);
+            }
+        }
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        p = lineEnd != nullptr ? lineEnd + 1 : end;
+    }
+    finishMesh(mesh, stats);
+    return mesh;
+}
+Mesh loadGltf(const std::string& path, MeshLoadStats& stats) {
+    std::vector<char> file = readFile(path);
+    stats.bytes += file.size();
+    std::string json;
+    std::vector<char> binChunk;
+    uint32_t magic = 0;
+    if (file.size() >= 12) {
+        memcpy(&magic, file.data(), 4);
+    }
+    if (magic == 0x46546c67) {
+        // .glb: 12 byte header followed by a JSON chunk and an optional BIN chunk
+        size_t offset = 12;
+        while (offset + 8 <= file.size()) {
+            uint32_t chunkLength;
+            uint32_t chunkType;
+            memcpy(&chunkLength, file.data() + offset, 4);
+            memcpy(&chunkType, file.data() + offset + 4, 4);
+            offset += 8;
+            if (offset + chunkLength > file.size()) {
+                throw std::runtime_error("VK Error: glb chunk out of file bounds in " + path);
+            }
+            if (chunkType == 0x4e4f534a) {
+                json.assign(file.data() + offset, chunkLength);
+            } else if (chunkType == 0x004e4942) {
+                binChunk.assign(file.data() + offset, file.data() + offset + chunkLength);
+            }
+            offset += chunkLength;
+        }
+    } else {
+        json.assign(file.data(), file.size());
+    }
+    JsonParser parser{.p = json.c_str(), .end = json.c_str() + json.size()};
+    JsonValue gltf = parser.parse();
+
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::vector<std::vector<char>> buffers;
+    if (const JsonValue* bufferList = gltf.find("buffers")) {
+        for (const JsonValue& buffer: bufferList->items) {
+            const JsonValue* uri = buffer.find("uri");
+            if (uri == nullptr) {
+                buffers.push_back(std::move(binChunk));
+            } else if (uri->string.rfind("data:", 0) == 0) {
+                buffers.push_back(decodeBase64(uri->string.substr(uri->string.find(',') + 1)));
+            } else {
+                buffers.push_back(readFile(directory + uri->string));
+                stats.bytes += buffers.back().size();
+            }
+        }
+    }
+
+    Mesh mesh;
+    mesh.name = path;
+    VertexDeduplicator deduplicator{.mesh = mesh, .indexOf = {}};
+    std::vector<Vertex> primitiveVertices;
+    const JsonValue* meshList = gltf.find("meshes");
+    for (size_t m=0; meshList != nullptr && m<meshList->items.size(); m++) {
+        for (const JsonValue& primitive: (*meshList)[m]["primitives"].items) {
+            // points, lines and strips are skipped
+            if (primitive.getUint("mode", 4) != 4) {
+                continue;
+            }
+            const JsonValue& attributes = primitive["attributes"];
+            AccessorView position = getAccessor(gltf, buffers, attributes.getUint("POSITION", UINT32_MAX));
+            std::optional<AccessorView> normal;
+            std::optional<AccessorView> uv;
+            if (attributes.find("NORMAL") != nullptr) {
+                normal = getAccessor(gltf, buffers, attributes.getUint("NORMAL", 0));
+            }
+            if (attributes.find("TEXCOORD_0") != nullptr) {
+                uv = getAccessor(gltf, buffers, attributes.getUint("TEXCOORD_0", 0));
+            }
+            primitiveVertices.resize(position.count);
+            for (uint32_t i=0; i<position.count; i++) {
+                Vertex& vertex = primitiveVertices[i];
+                vertex = Vertex{position.readFloat(i, 0), position.readFloat(i, 1), position.readFloat(i, 2), 
+                    0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+                if (normal.has_value() && i < normal->count) {
+                    vertex.nx = normal->readFloat(i, 0);
+                    vertex.ny = normal->readFloat(i, 1);
+                    vertex.nz = normal->readFloat(i, 2);
+                }
+                if (uv.has_value() && i < uv->count) {
+                    vertex.u = uv->readFloat(i, 0);
+                    vertex.v = uv->readFloat(i, 1);
+                }
+            }
+            if (primitive.find("indices") != nullptr) {
+                AccessorView indexView = getAccessor(gltf, buffers, primitive.getUint("indices", 0));
+                for (uint32_t i=0; i+2<indexView.count; i+=3) {
+                    for (uint32_t corner=0; corner<3; corner++) {
+                        uint32_t index = indexView.readIndex(i+corner);
+                        if (index >= primitiveVertices.size()) {
+                            throw std::runtime_error("VK Error: glTF index out of vertex range in " + path);
+                        }
+                        deduplicator.add(primitiveVertices[index]);
+                    }
+                }
+            } else {
+                for (uint32_t i=0; i+2<position.count; i+=3) {
+                    deduplicator.add(primitiveVertices[i]);
+                    deduplicator.add(primitiveVertices[i+1]);
+                    deduplicator.add(primitiveVertices[i+2]);
+                }
+            }
+        }
+    }
+    finishMesh(mesh, stats);
+    return mesh;
+}
+Mesh loadMesh(const std::string& path, MeshLoadStats& stats) {
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (extension == "obj") {
+        return loadObj(path, stats);
+    }
+    if (extension == "gltf" || extension == "glb") {
+        return loadGltf(path, stats);
+    }
+    throw std::runtime_error("VK Error: unsupported mesh format " + path);
+}
+std::vector<Mesh> loadMeshes(const std::vector<std::string>& paths, ThreadPool& pool, MeshLoadStats& stats) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::vector<Mesh> meshes(paths.size());
+    std::vector<MeshLoadStats> fileStats(paths.size());
+    for (size_t i=0; i<paths.size(); i++) {
+        pool.submit([&, i] {
+            meshes[i] = loadMesh(paths[i], fileStats[i]);
+            optimizeMesh(meshes[i], fileStats[i]);
+            buildLods(meshes[i], fileStats[i]);
+        });
+    }
+    pool.wait();
+    for (auto& file: fileStats) {
+        stats.fileCount += file.fileCount;
+        stats.bytes += file.bytes;
+        stats.triangles += file.triangles;
+        stats.inputVertices += file.inputVertices;
+        stats.uniqueVertices += file.uniqueVertices;
+        stats.cacheMissesBefore += file.cacheMissesBefore;
+        stats.cacheMissesAfter += file.cacheMissesAfter;
+        stats.lodTriangles += file.lodTriangles;
+    }
+    stats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+    return meshes;
+}
+Mesh createQuadMesh() {
+    return Mesh{
+        .name = "quad",
+        .vertices = {
+            {-0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f},
+            {0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f},
+            {0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f},
+            {-0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}
+        },
+        .indices = {
+            0, 1, 2, 2, 3, 0
+        }
+    };
+}
+namespace {
+
+uint16_t quantizeUnorm16(float value) {
+    return (uint16_t)std::lround(std::clamp(value, 0.0f, 1.0f)*65535.0f);
+}
+int16_t quantizeSnorm16(float value) {
+    return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f)*32767.0f);
+}
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent <= 0) {
+        // too small even for a denormal half at uv precision, flush to zero
+        return (uint16_t)sign;
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7bff);
+    }
+    // round to nearest, a carry into the exponent is still the correctly rounded value
+    return (uint16_t)(sign + ((uint32_t)exponent << 10) + (mantissa >> 13) + ((mantissa >> 12) & 1));
+}
+// octahedral projection onto the |x|+|y|=1 square, the lower hemisphere folded over the diagonals
+void encodeOctahedral(float x, float y, float z, int16_t& outX, int16_t& outY) {
+    float length = std::abs(x) + std::abs(y) + std::abs(z);
+    if (length == 0.0f) {
+        outX = 0;
+        outY = 0;
+        return;
+    }
+    x /= length;
+    y /= length;
+    if (z < 0.0f) {
+        float foldedX = (1.0f - std::abs(y))*(x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x))*(y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    outX = quantizeSnorm16(x);
+    outY = quantizeSnorm16(y);
+}
+
+}
+
+void packGeometry(const std::vector<Mesh>& meshes, bool quantize, std::vector<uint8_t>& vertexData, 
+    std::vector<uint8_t>& indexData, std::vector<MeshRange>& ranges) {
+    constexpr size_t meshAlignment = std::max(sizeof(Vertex), sizeof(PackedVertex));
+    for (auto& mesh: meshes) {
+        if (mesh.indices.empty()) {
+            continue;
+        }
+        vertexData.resize((vertexData.size() + meshAlignment - 1)/meshAlignment*meshAlignment);
+        size_t byteOffset = vertexData.size();
+        // indices are relative to the mesh, so a small mesh fits 16 bit indices wherever it lands
+        uint32_t indexSize = mesh.vertices.size() < 65536 ? 2 : 4;
+        indexData.resize((indexData.size() + 3)/4*4);
+        MeshRange range{
+            .vertexOffset = (int32_t)(byteOffset/sizeof(Vertex)),
+            .vertexCount = (uint32_t)mesh.vertices.size(),
+            .vertexFormat = VertexFormat::Float32,
+            .indexSize = indexSize,
+            .positionOffset = {0.0f, 0.0f, 0.0f},
+            .positionScale = {1.0f, 1.0f, 1.0f},
+            .boundsCenter = {0.0f, 0.0f, 0.0f},
+            .boundsRadius = 0.0f,
+            .lodCount = 0,
+            .lods = {}
+        };
+        // sphere around the AABB center, looser than an optimal one but found in a single pass
+        constexpr float maxFloat = std::numeric_limits<float>::max();
+        float boundsMin[3] = {maxFloat, maxFloat, maxFloat};
+        float boundsMax[3] = {-maxFloat, -maxFloat, -maxFloat};
+        for (auto& vertex: mesh.vertices) {
+            const float position[3] = {vertex.vx, vertex.vy, vertex.vz};
+            for (int axis=0; axis<3; axis++) {
+                boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+            }
+        }
+        for (int axis=0; axis<3; axis++) {
+            range.boundsCenter[axis] = (boundsMin[axis] + boundsMax[axis])*0.5f;
+        }
+        for (auto& vertex: mesh.vertices) {
+            float dx = vertex.vx - range.boundsCenter[0];
+            float dy = vertex.vy - range.boundsCenter[1];
+            float dz = vertex.vz - range.boundsCenter[2];
+            range.boundsRadius = std::max(range.boundsRadius, dx*dx + dy*dy + dz*dz);
+        }
+        range.boundsRadius = std::sqrt(range.boundsRadius);
+
+        // the levels of detail follow the full mesh, all of them over the same vertices
+        for (size_t lod=0; lod<=mesh.lods.size() && lod<MAX_MESH_LODS; lod++) {
+            const std::vector<uint32_t>& indices = lod == 0 ? mesh.indices : mesh.lods[lod - 1];
+            size_t lodOffset = indexData.size();
+            range.lods[lod] = MeshLod{
+                .firstIndex = (uint32_t)(lodOffset/indexSize),
+                .indexCount = (uint32_t)indices.size(),
+                .error = lod == 0 ? 0.0f : mesh.lodErrors[lod - 1]
+            };
+            range.lodCount++;
+            indexData.resize(lodOffset + indices.size()*indexSize);
+            if (indexSize == 4) {
+                memcpy(indexData.data() + lodOffset, indices.data(), indices.size()*4);
+            } else {
+                uint16_t* shortIndices = reinterpret_cast<uint16_t*>(indexData.data() + lodOffset);
+                for (size_t i=0; i<indices.size(); i++) {
+                    shortIndices[i] = (uint16_t)indices[i];
+                }
+            }
+        }
+        if (!quantize) {
+            vertexData.resize(byteOffset + mesh.vertices.size()*sizeof(Vertex));
+            memcpy(vertexData.data() + byteOffset, mesh.vertices.data(), mesh.vertices.size()*sizeof(Vertex));
+            ranges.push_back(range);
+            continue;
+        }
+
+        bool unormUv = true;
+        for (auto& vertex: mesh.vertices) {
+            unormUv = unormUv && vertex.u >= 0.0f && vertex.u <= 1.0f && vertex.v >= 0.0f && vertex.v <= 1.0f;
+        }
+        range.vertexOffset = (int32_t)(byteOffset/sizeof(PackedVertex));
+        range.vertexFormat = unormUv ? VertexFormat::Quantized : VertexFormat::QuantizedHalfUv;
+        float inverseExtent[3];
+        for (int axis=0; axis<3; axis++) {
+            float extent = boundsMax[axis] - boundsMin[axis];
+            range.positionOffset[axis] = boundsMin[axis];
+            range.positionScale[axis] = extent;
+            inverseExtent[axis] = extent > 0.0f ? 1.0f/extent : 0.0f;
+        }
+        vertexData.resize(byteOffset + mesh.vertices.size()*sizeof(PackedVertex));
+        PackedVertex* packed = reinterpret_cast<PackedVertex*>(vertexData.data() + byteOffset);
+        for (size_t i=0; i<mesh.vertices.size(); i++) {
+            const Vertex& vertex = mesh.vertices[i];
+            packed[i].px = quantizeUnorm16((vertex.vx - boundsMin[0])*inverseExtent[0]);
+            packed[i].py = quantizeUnorm16((vertex.vy - boundsMin[1])*inverseExtent[1]);
+            packed[i].pz = quantizeUnorm16((vertex.vz - boundsMin[2])*inverseExtent[2]);
+            packed[i].pad = 0;
+            encodeOctahedral(vertex.nx, vertex.ny, vertex.nz, packed[i].nx, packed[i].ny);
+            packed[i].u = unormUv ? quantizeUnorm16(vertex.u) : floatToHalf(vertex.u);
+            packed[i].v = unormUv ? quantizeUnorm16(vertex.v) : floatToHalf(vertex.v);
+        }
+        ranges.push_back(range);
+    }
+}
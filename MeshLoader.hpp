@@ -0,0 +1,86 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+#include "ThreadPool.hpp"
+
+struct Vertex {
+    float vx, vy, vz;
+    float nx, ny, nz;
+    float u, v;
+};
+struct Mesh {
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    // coarser index lists over the same vertices from buildLods, with their error in mesh space units
+    std::vector<std::vector<uint32_t>> lods;
+    std::vector<float> lodErrors;
+};
+enum class VertexFormat : uint32_t {
+    Float32,
+    // unorm16 position within the mesh bounds, octahedral snorm16 normal, unorm16 uv
+    Quantized,
+    // same with half float uvs, for meshes with uvs outside [0, 1]
+    QuantizedHalfUv
+};
+// 16 byte counterpart of Vertex, decoded in render.vert
+struct PackedVertex {
+    uint16_t px, py, pz, pad;
+    int16_t nx, ny;
+    uint16_t u, v;
+};
+// level 0 is the full mesh
+constexpr uint32_t MAX_MESH_LODS = 4;
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // largest deviation from the full mesh in mesh space units, for screen-space error selection
+    float error;
+};
+// where a mesh ended up in the shared vertex and index buffers
+struct MeshRange {
+    // counted in vertices of the mesh's own format, meshes start on a multiple of every stride
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    VertexFormat vertexFormat;
+    // 2 for meshes with fewer than 65536 vertices, else 4; firstIndex counts indices of this size
+    uint32_t indexSize;
+    // quantized formats: position = positionOffset + position decoded to [0, 1] * positionScale
+    float positionOffset[3];
+    float positionScale[3];
+    // bounding sphere in mesh space, for culling
+    float boundsCenter[3];
+    float boundsRadius;
+    // every level indexes the same vertices, firstIndex counts indices of indexSize
+    uint32_t lodCount;
+    MeshLod lods[MAX_MESH_LODS];
+};
+struct MeshLoadStats {
+    uint32_t fileCount = 0;
+    uint64_t bytes = 0;
+    uint64_t triangles = 0;
+    // triangle corners before deduplication and the vertices left after it
+    uint64_t inputVertices = 0;
+    uint64_t uniqueVertices = 0;
+    double seconds = 0.0;
+    // post-transform cache misses with a 16 entry FIFO around optimizeMesh
+    uint64_t cacheMissesBefore = 0;
+    uint64_t cacheMissesAfter = 0;
+    // triangles in the levels of detail below the full meshes
+    uint64_t lodTriangles = 0;
+};
+
+// Wavefront OBJ, polygons are fan triangulated. A missing normal becomes +z, a missing uv 0.
+Mesh loadObj(const std::string& path, MeshLoadStats& stats);
+// glTF 2.0, .gltf with external or base64 buffers and .glb. Every triangle primitive of every
+// mesh is merged in mesh space, node transforms are not applied.
+Mesh loadGltf(const std::string& path, MeshLoadStats& stats);
+// picks the parser from the extension
+Mesh loadMesh(const std::string& path, MeshLoadStats& stats);
+// one job per file on the pool, each mesh is run through optimizeMesh and buildLods, the result keeps the order of `paths`
+std::vector<Mesh> loadMeshes(const std::vector<std::string>& paths, ThreadPool& pool, MeshLoadStats& stats);
+Mesh createQuadMesh();
+// Appends every mesh to one vertex blob and one index blob. With `quantize` each mesh is encoded
+// as Quantized, or QuantizedHalfUv when its uvs don't fit unorm16, otherwise as Float32.
+void packGeometry(const std::vector<Mesh>& meshes, bool quantize, std::vector<uint8_t>& vertexData, 
+    std::vector<uint8_t>& indexData, std::vector<MeshRange>& ranges);
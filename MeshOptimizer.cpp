@@ -0,0 +1,236 @@
+#include "MeshOptimizer.hpp"
+
+namespace {
+
+// scoring of Forsyth's algorithm, the cache modelled here is larger than the one ACMR is measured with
+constexpr uint32_t SCORE_CACHE_SIZE = 32;
+constexpr uint32_t MAX_VALENCE = 32;
+
+struct ScoreTables {
+    float cache[SCORE_CACHE_SIZE];
+    float valence[MAX_VALENCE + 1];
+
+    ScoreTables() {
+        for (uint32_t i=0; i<SCORE_CACHE_SIZE; i++) {
+            // the last triangle's vertices get a fixed score so it isn't immediately reused
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (float)(i - 3)/(SCORE_CACHE_SIZE - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (uint32_t i=1; i<=MAX_VALENCE; i++) {
+            valence[i] = 2.0f/std::sqrt((float)i);
+        }
+    }
+    float getVertexScore(int32_t cachePosition, uint32_t remainingTriangles) const {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return score + valence[std::min(remainingTriangles, MAX_VALENCE)];
+    }
+};
+
+}
+
+uint64_t countCacheMisses(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+    // timestamps instead of a queue: a vertex is cached while fewer than cacheSize misses followed it
+    std::vector<uint64_t> loadedAt(vertexCount, 0);
+    uint64_t misses = 0;
+    for (uint32_t index: indices) {
+        if (loadedAt[index] == 0 || misses - loadedAt[index] + 1 > cacheSize) {
+            misses++;
+            loadedAt[index] = misses;
+        }
+    }
+    return misses;
+}
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+    static const ScoreTables tables;
+    size_t triangleCount = indices.size()/3;
+    if (triangleCount == 0) {
+        return;
+    }
+    // triangles of each vertex, shrunk as they are emitted
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index: indices) {
+        remaining[index]++;
+    }
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v=0; v<vertexCount; v++) {
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> filled(vertexCount, 0);
+    for (size_t t=0; t<triangleCount; t++) {
+        for (int corner=0; corner<3; corner++) {
+            uint32_t v = indices[t*3 + corner];
+            adjacency[firstTriangle[v] + filled[v]++] = (uint32_t)t;
+        }
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v=0; v<vertexCount; v++) {
+        vertexScore[v] = tables.getVertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t=0; t<triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t*3]] + vertexScore[indices[t*3 + 1]] + vertexScore[indices[t*3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    uint32_t cache[SCORE_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    uint32_t newCache[SCORE_CACHE_SIZE + 3];
+    // fallback when nothing in the cache has triangles left: the next one in input order
+    size_t inputCursor = 0;
+    uint32_t best = 0;
+    while (true) {
+        emitted[best] = true;
+        uint32_t a = indices[best*3];
+        uint32_t b = indices[best*3 + 1];
+        uint32_t c = indices[best*3 + 2];
+        output.insert(output.end(), {a, b, c});
+
+        uint32_t newCount = 0;
+        newCache[newCount++] = a;
+        newCache[newCount++] = b;
+        newCache[newCount++] = c;
+        for (uint32_t i=0; i<cacheCount; i++) {
+            if (cache[i] != a && cache[i] != b && cache[i] != c) {
+                newCache[newCount++] = cache[i];
+            }
+        }
+        for (uint32_t v: {a, b, c}) {
+            uint32_t* begin = adjacency.data() + firstTriangle[v];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, best) = end[-1];
+            remaining[v]--;
+        }
+        // vertices falling out of the cache lose their cache score but still need an update
+        for (uint32_t i=0; i<newCount; i++) {
+            cachePosition[newCache[i]] = i < SCORE_CACHE_SIZE ? (int32_t)i : -1;
+        }
+        float bestScore = -1.0f;
+        uint32_t bestCandidate = UINT32_MAX;
+        for (uint32_t i=0; i<newCount; i++) {
+            uint32_t v = newCache[i];
+            float scoreChange = tables.getVertexScore(cachePosition[v], remaining[v]) - vertexScore[v];
+            vertexScore[v] += scoreChange;
+            for (uint32_t k=0; k<remaining[v]; k++) {
+                uint32_t t = adjacency[firstTriangle[v] + k];
+                triangleScore[t] += scoreChange;
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestCandidate = t;
+                }
+            }
+        }
+        cacheCount = std::min(newCount, SCORE_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        if (bestCandidate == UINT32_MAX) {
+            while (inputCursor < triangleCount && emitted[inputCursor]) {
+                inputCursor++;
+            }
+            if (inputCursor == triangleCount) {
+                break;
+            }
+            bestCandidate = (uint32_t)inputCursor;
+        }
+        best = bestCandidate;
+    }
+    indices = std::move(output);
+}
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float acmrThreshold) {
+    size_t triangleCount = indices.size()/3;
+    if (triangleCount == 0) {
+        return;
+    }
+    // clusters start where the cache-optimized order had to restart: all three vertices missed
+    std::vector<size_t> clusterStarts;
+    std::vector<uint64_t> loadedAt(vertices.size(), 0);
+    uint64_t misses = 0;
+    for (size_t t=0; t<triangleCount; t++) {
+        uint32_t triangleMisses = 0;
+        for (int corner=0; corner<3; corner++) {
+            uint32_t v = indices[t*3 + corner];
+            if (loadedAt[v] == 0 || misses - loadedAt[v] + 1 > 16) {
+                misses++;
+                triangleMisses++;
+                loadedAt[v] = misses;
+            }
+        }
+        if (t == 0 || triangleMisses == 3) {
+            clusterStarts.push_back(t);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    if (clusterStarts.size() <= 2) {
+        return;
+    }
+
+    auto position = [&](uint32_t index) {
+        const Vertex& v = vertices[index];
+        return glm::vec3(v.vx, v.vy, v.vz);
+    };
+    glm::vec3 meshCentroid(0.0f);
+    for (const Vertex& vertex: vertices) {
+        meshCentroid += glm::vec3(vertex.vx, vertex.vy, vertex.vz);
+    }
+    meshCentroid /= (float)vertices.size();
+    // clusters facing away from the center and lying far out along that direction are likely
+    // to occlude the rest, so they go first
+    std::vector<std::pair<float, size_t>> clusterKeys;
+    for (size_t c=0; c+1<clusterStarts.size(); c++) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t=clusterStarts[c]; t<clusterStarts[c + 1]; t++) {
+            glm::vec3 p0 = position(indices[t*3]);
+            glm::vec3 p1 = position(indices[t*3 + 1]);
+            glm::vec3 p2 = position(indices[t*3 + 2]);
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(cross);
+            centroid += (p0 + p1 + p2)*(triangleArea/3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        centroid = area > 0.0f ? centroid/area : position(indices[clusterStarts[c]*3]);
+        float normalLength = glm::length(normal);
+        float key = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal/normalLength) : 0.0f;
+        clusterKeys.emplace_back(key, c);
+    }
+    std::stable_sort(clusterKeys.begin(), clusterKeys.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (auto& [key, c]: clusterKeys) {
+        sorted.insert(sorted.end(), indices.begin() + clusterStarts[c]*3, indices.begin() + clusterStarts[c + 1]*3);
+    }
+    uint64_t sortedMisses = countCacheMisses(sorted, vertices.size());
+    if (sortedMisses <= countCacheMisses(indices, vertices.size())*acmrThreshold) {
+        indices = std::move(sorted);
+    }
+}
+void optimizeVertexFetch(Mesh& mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index: mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+void optimizeMesh(Mesh& mesh, MeshLoadStats& stats) {
+    stats.cacheMissesBefore += countCacheMisses(mesh.indices, mesh.vertices.size());
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices, 1.05f);
+    optimizeVertexFetch(mesh);
+    stats.cacheMissesAfter += countCacheMisses(mesh.indices, mesh.vertices.size());
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "config.hpp"
+#include "MeshLoader.hpp"
+
+// Import-time index and vertex reordering. optimizeMesh runs the whole chain: triangle order
+// for the post-transform cache, then for overdraw, then vertex order for fetch locality.
+
+// vertex shader invocations of `indices` drawn through a FIFO post-transform cache
+uint64_t countCacheMisses(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+// Forsyth's linear-speed vertex cache optimization
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+// Sorts cache-coherent clusters of triangles front to back from the outside in, the result is
+// only kept while its cache misses stay within acmrThreshold of the input.
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float acmrThreshold);
+// renumbers vertices in the order the indices first reference them, drops unreferenced ones
+void optimizeVertexFetch(Mesh& mesh);
+void optimizeMesh(Mesh& mesh, MeshLoadStats& stats);
@@ -0,0 +1,124 @@
+#include "MeshPack.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("VK Error: cannot open " + path);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("VK Error: cannot map empty file " + path);
+    }
+    size = (size_t)fileStat.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        throw std::runtime_error("VK Error: cannot map " + path);
+    }
+    // every byte is read once front to back while staging, let the kernel read ahead aggressively;
+    // advice values are not flags, so each hint is its own call
+    if (madvise(mapping, size, MADV_SEQUENTIAL) != 0 || madvise(mapping, size, MADV_WILLNEED) != 0) {
+        munmap(mapping, size);
+        size = 0;
+        throw std::runtime_error("VK Error: cannot advise the mapping of " + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+}
+void MappedFile::close() {
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+void MeshPack::open(const std::string& path) {
+    file.open(path);
+    const MeshPackHeader* fileHeader = reinterpret_cast<const MeshPackHeader*>(file.data);
+    if (file.size < sizeof(MeshPackHeader) || fileHeader->magic != MESH_PACK_MAGIC || fileHeader->version != MESH_PACK_VERSION) {
+        file.close();
+        throw std::runtime_error("VK Error: not a version " + std::to_string(MESH_PACK_VERSION) + " mesh pack " + path);
+    }
+    uint64_t tableEnd = sizeof(MeshPackHeader) + (uint64_t)fileHeader->meshCount*sizeof(MeshRange);
+    if (fileHeader->vertexStride != sizeof(Vertex) || tableEnd > file.size || 
+        !file.contains(fileHeader->vertexOffset, fileHeader->vertexBytes) || !file.contains(fileHeader->indexOffset, fileHeader->indexBytes)) {
+        file.close();
+        throw std::runtime_error("VK Error: corrupt mesh pack " + path);
+    }
+    // the ranges end up in draws, one out of its blob would have the GPU read past the buffers
+    const MeshRange* ranges = reinterpret_cast<const MeshRange*>(file.data + sizeof(MeshPackHeader));
+    for (uint32_t i=0; i<fileHeader->meshCount; i++) {
+        const MeshRange& range = ranges[i];
+        uint64_t stride = range.vertexFormat == VertexFormat::Float32 ? sizeof(Vertex) : sizeof(PackedVertex);
+        // lods is a fixed array, lodCount indexes it on the host
+        bool valid = (range.indexSize == 2 || range.indexSize == 4) && range.vertexFormat <= VertexFormat::QuantizedHalfUv &&
+            range.vertexOffset >= 0 && (uint64_t)range.vertexOffset*stride < fileHeader->vertexBytes &&
+            (uint64_t)range.vertexCount*stride <= fileHeader->vertexBytes - (uint64_t)range.vertexOffset*stride &&
+            range.lodCount > 0 && range.lodCount <= MAX_MESH_LODS;
+        for (uint32_t lod=0; valid && lod<range.lodCount; lod++) {
+            valid = ((uint64_t)range.lods[lod].firstIndex + range.lods[lod].indexCount)*range.indexSize <= fileHeader->indexBytes;
+        }
+        if (!valid) {
+            file.close();
+            throw std::runtime_error("VK Error: corrupt mesh pack " + path);
+        }
+    }
+    header = fileHeader;
+    meshes = ranges;
+    vertexData = file.data + header->vertexOffset;
+    indexData = file.data + header->indexOffset;
+}
+void MeshPack::close() {
+    file.close();
+    header = nullptr;
+    meshes = nullptr;
+    vertexData = nullptr;
+    indexData = nullptr;
+}
+
+void writeMeshPack(const std::string& path, const std::vector<Mesh>& meshes, bool quantize) {
+    auto align = [](uint64_t offset) {
+        return (offset + MESH_PACK_ALIGNMENT - 1)/MESH_PACK_ALIGNMENT*MESH_PACK_ALIGNMENT;
+    };
+    // the same packing the engine does for loose files, so the blobs can be uploaded as they are
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    std::vector<MeshRange> table;
+    packGeometry(meshes, quantize, vertexData, indexData, table);
+    MeshPackHeader header{
+        .magic = MESH_PACK_MAGIC,
+        .version = MESH_PACK_VERSION,
+        .meshCount = (uint32_t)table.size(),
+        .vertexStride = sizeof(Vertex),
+        .vertexOffset = align(sizeof(MeshPackHeader) + table.size()*sizeof(MeshRange)),
+        .vertexBytes = vertexData.size(),
+        .indexOffset = 0,
+        .indexBytes = indexData.size()
+    };
+    header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("VK Error: cannot write " + path);
+    }
+    auto pad = [&](uint64_t offset) {
+        static const char zeros[MESH_PACK_ALIGNMENT] = {};
+        file.write(zeros, (std::streamsize)(offset - (uint64_t)file.tellp()));
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), (std::streamsize)(table.size()*sizeof(MeshRange)));
+    pad(header.vertexOffset);
+    file.write(reinterpret_cast<const char*>(vertexData.data()), (std::streamsize)vertexData.size());
+    pad(header.indexOffset);
+    file.write(reinterpret_cast<const char*>(indexData.data()), (std::streamsize)indexData.size());
+    if (!file) {
+        throw std::runtime_error("VK Error: cannot write " + path);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+#include "MeshLoader.hpp"
+
+// Binary mesh pack: header, mesh table, then the vertex and index blobs in the layout the GPU
+// buffers use, each starting on a MESH_PACK_ALIGNMENT boundary.
+struct MeshPackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t meshCount;
+    // stride of VertexFormat::Float32, each mesh's format is in its table entry
+    uint32_t vertexStride;
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+};
+constexpr uint32_t MESH_PACK_MAGIC = 0x504d4b56;
+constexpr uint32_t MESH_PACK_VERSION = 6;
+// page sized so the blobs stay suitable for mapping or importing on their own
+constexpr uint64_t MESH_PACK_ALIGNMENT = 4096;
+
+// read-only mapping of a whole file, pages are faulted in as they are read
+struct MappedFile {
+    void open(const std::string& path);
+    void close();
+    // whether [offset, offset + bytes) lies inside the file, for offsets and lengths read from it
+    bool contains(uint64_t offset, uint64_t bytes) const { return offset <= size && bytes <= size - offset; }
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+struct MeshPack {
+    void open(const std::string& path);
+    void close();
+    bool isOpen() { return header != nullptr; }
+
+    MappedFile file;
+    const MeshPackHeader* header = nullptr;
+    // entries are MeshRanges into the packed buffers
+    const MeshRange* meshes = nullptr;
+    const void* vertexData = nullptr;
+    const void* indexData = nullptr;
+};
+
+void writeMeshPack(const std::string& path, const std::vector<Mesh>& meshes, bool quantize);
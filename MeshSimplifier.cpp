@@ -0,0 +1,378 @@
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+
+namespace {
+
+// normal xyz and uv
+constexpr int ATTRIBUTE_COUNT = 5;
+// squared attribute deviation against squared distance, positions are normalized to a unit extent
+constexpr float ATTRIBUTE_WEIGHTS[ATTRIBUTE_COUNT] = {0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+// planes through open edges, perpendicular to their triangle, keep the outline in place
+constexpr float BORDER_WEIGHT = 10.0f;
+// a collapse may turn no remaining triangle's normal by more than about 75 degrees
+constexpr float FLIP_THRESHOLD = 0.25f;
+// levels shrinking less than this are not worth their index data
+constexpr float MIN_LOD_REDUCTION = 0.8f;
+constexpr size_t MIN_LOD_TRIANGLES = 64;
+
+enum class VertexKind : uint8_t {
+    Manifold,
+    // on an open edge, collapses only along it
+    Border,
+    // seams, non-manifold edges and borders meeting in a corner never move
+    Locked
+};
+
+// Sums of area weighted squared distances to planes, plus Hoppe's attribute quadrics: each
+// triangle's attributes as a linear function g.p + d over its plane, so the error of keeping
+// attribute value s at position p is the squared difference (g.p + d - s)^2.
+struct Quadric {
+    // symmetric 4x4 form: a00 a11 a22 a01 a12 a02 b0 b1 b2 c
+    float plane[10] = {};
+    // total weight of the planes, the error is their weighted average
+    float weight = 0.0f;
+    // triangle area, the attribute terms are weighted by area times ATTRIBUTE_WEIGHTS
+    float area = 0.0f;
+    float gradients[ATTRIBUTE_COUNT][3] = {};
+    float offsets[ATTRIBUTE_COUNT] = {};
+
+    void addPlane(const glm::vec3& n, float d, float w) {
+        plane[0] += w*n.x*n.x;
+        plane[1] += w*n.y*n.y;
+        plane[2] += w*n.z*n.z;
+        plane[3] += w*n.x*n.y;
+        plane[4] += w*n.y*n.z;
+        plane[5] += w*n.x*n.z;
+        plane[6] += w*n.x*d;
+        plane[7] += w*n.y*d;
+        plane[8] += w*n.z*d;
+        plane[9] += w*d*d;
+    }
+    void add(const Quadric& other) {
+        for (int i=0; i<10; i++) {
+            plane[i] += other.plane[i];
+        }
+        weight += other.weight;
+        area += other.area;
+        for (int a=0; a<ATTRIBUTE_COUNT; a++) {
+            for (int axis=0; axis<3; axis++) {
+                gradients[a][axis] += other.gradients[a][axis];
+            }
+            offsets[a] += other.offsets[a];
+        }
+    }
+    // weighted sum of squared errors, not yet divided by weight
+    float evaluate(const glm::vec3& p, const float* attributes) const {
+        float error = plane[0]*p.x*p.x + plane[1]*p.y*p.y + plane[2]*p.z*p.z +
+            2.0f*(plane[3]*p.x*p.y + plane[4]*p.y*p.z + plane[5]*p.x*p.z) +
+            2.0f*(plane[6]*p.x + plane[7]*p.y + plane[8]*p.z) + plane[9];
+        for (int a=0; a<ATTRIBUTE_COUNT; a++) {
+            float s = attributes[a];
+            float linear = gradients[a][0]*p.x + gradients[a][1]*p.y + gradients[a][2]*p.z + offsets[a];
+            error += s*s*area*ATTRIBUTE_WEIGHTS[a] - 2.0f*s*linear;
+        }
+        return error;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+};
+
+uint64_t getEdgeKey(uint32_t a, uint32_t b) {
+    return (uint64_t)a << 32 | b;
+}
+
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+    size_t targetIndexCount, float maxError, float& error) {
+    error = 0.0f;
+    size_t vertexCount = vertices.size();
+    if (indices.size() <= targetIndexCount || vertexCount == 0) {
+        return indices;
+    }
+    // positions normalized to a unit extent, so the weights and thresholds hold for any mesh size
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (auto& vertex: vertices) {
+        boundsMin = glm::min(boundsMin, glm::vec3(vertex.vx, vertex.vy, vertex.vz));
+        boundsMax = glm::max(boundsMax, glm::vec3(vertex.vx, vertex.vy, vertex.vz));
+    }
+    float extent = std::max({boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z});
+    float scale = extent > 0.0f ? 1.0f/extent : 1.0f;
+    std::vector<glm::vec3> positions(vertexCount);
+    std::vector<float> attributes(vertexCount*ATTRIBUTE_COUNT);
+    for (size_t v=0; v<vertexCount; v++) {
+        const Vertex& vertex = vertices[v];
+        positions[v] = (glm::vec3(vertex.vx, vertex.vy, vertex.vz) - boundsMin)*scale;
+        float* vertexAttributes = &attributes[v*ATTRIBUTE_COUNT];
+        vertexAttributes[0] = vertex.nx;
+        vertexAttributes[1] = vertex.ny;
+        vertexAttributes[2] = vertex.nz;
+        vertexAttributes[3] = vertex.u;
+        vertexAttributes[4] = vertex.v;
+    }
+
+    // vertices sharing a position are one point of the surface: edges are matched up by position,
+    // so a seam doesn't look like two open borders
+    std::vector<uint32_t> sortedVertices(vertexCount);
+    for (uint32_t v=0; v<vertexCount; v++) {
+        sortedVertices[v] = v;
+    }
+    auto lessPosition = [&](uint32_t a, uint32_t b) {
+        const glm::vec3& pa = positions[a];
+        const glm::vec3& pb = positions[b];
+        return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+    };
+    std::sort(sortedVertices.begin(), sortedVertices.end(), lessPosition);
+    std::vector<uint32_t> canonical(vertexCount);
+    std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+    for (size_t begin=0; begin<vertexCount;) {
+        size_t end = begin + 1;
+        while (end < vertexCount && positions[sortedVertices[end]] == positions[sortedVertices[begin]]) {
+            end++;
+        }
+        for (size_t i=begin; i<end; i++) {
+            canonical[sortedVertices[i]] = sortedVertices[begin];
+            if (end - begin > 1) {
+                kinds[sortedVertices[i]] = VertexKind::Locked;
+            }
+        }
+        begin = end;
+    }
+
+    std::vector<uint32_t> result = indices;
+    std::vector<uint64_t> halfEdges;
+    auto collectHalfEdges = [&] {
+        halfEdges.clear();
+        for (size_t i=0; i<result.size(); i+=3) {
+            for (int corner=0; corner<3; corner++) {
+                halfEdges.push_back(getEdgeKey(canonical[result[i + corner]], canonical[result[i + (corner + 1)%3]]));
+            }
+        }
+        std::sort(halfEdges.begin(), halfEdges.end());
+    };
+    auto isBorder = [&](uint32_t a, uint32_t b) {
+        return !std::binary_search(halfEdges.begin(), halfEdges.end(), getEdgeKey(canonical[b], canonical[a]));
+    };
+
+    collectHalfEdges();
+    std::vector<uint32_t> borderEdgeCounts(vertexCount, 0);
+    for (size_t i=0; i<result.size(); i+=3) {
+        for (int corner=0; corner<3; corner++) {
+            uint32_t a = result[i + corner];
+            uint32_t b = result[i + (corner + 1)%3];
+            auto range = std::equal_range(halfEdges.begin(), halfEdges.end(), getEdgeKey(canonical[a], canonical[b]));
+            if (range.second - range.first > 1) {
+                kinds[a] = VertexKind::Locked;
+                kinds[b] = VertexKind::Locked;
+            } else if (isBorder(a, b)) {
+                borderEdgeCounts[a]++;
+                borderEdgeCounts[b]++;
+            }
+        }
+    }
+    for (size_t v=0; v<vertexCount; v++) {
+        if (kinds[v] == VertexKind::Manifold && borderEdgeCounts[v] > 0) {
+            kinds[v] = borderEdgeCounts[v] == 2 ? VertexKind::Border : VertexKind::Locked;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i=0; i<result.size(); i+=3) {
+        uint32_t corners[3] = {result[i], result[i + 1], result[i + 2]};
+        glm::vec3 p0 = positions[corners[0]];
+        glm::vec3 e1 = positions[corners[1]] - p0;
+        glm::vec3 e2 = positions[corners[2]] - p0;
+        glm::vec3 normal = glm::cross(e1, e2);
+        float length = glm::length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        float area = length*0.5f;
+        Quadric quadric;
+        glm::vec3 unitNormal = normal/length;
+        quadric.addPlane(unitNormal, -glm::dot(unitNormal, p0), area);
+        quadric.weight = area;
+        quadric.area = area;
+        // the gradient g satisfies g.e1 = s1 - s0, g.e2 = s2 - s0 and lies in the plane
+        glm::vec3 basis1 = glm::cross(e2, normal)/(length*length);
+        glm::vec3 basis2 = glm::cross(normal, e1)/(length*length);
+        for (int a=0; a<ATTRIBUTE_COUNT; a++) {
+            float s0 = attributes[corners[0]*ATTRIBUTE_COUNT + a];
+            float s1 = attributes[corners[1]*ATTRIBUTE_COUNT + a];
+            float s2 = attributes[corners[2]*ATTRIBUTE_COUNT + a];
+            glm::vec3 gradient = basis1*(s1 - s0) + basis2*(s2 - s0);
+            float offset = s0 - glm::dot(gradient, p0);
+            float weight = area*ATTRIBUTE_WEIGHTS[a];
+            quadric.addPlane(gradient, offset, weight);
+            for (int axis=0; axis<3; axis++) {
+                quadric.gradients[a][axis] = gradient[axis]*weight;
+            }
+            quadric.offsets[a] = offset*weight;
+        }
+        for (uint32_t corner: corners) {
+            quadrics[corner].add(quadric);
+        }
+        for (int corner=0; corner<3; corner++) {
+            uint32_t a = corners[corner];
+            uint32_t b = corners[(corner + 1)%3];
+            if (!isBorder(a, b)) {
+                continue;
+            }
+            glm::vec3 edge = positions[b] - positions[a];
+            glm::vec3 borderNormal = glm::cross(edge, unitNormal);
+            float borderLength = glm::length(borderNormal);
+            if (borderLength == 0.0f) {
+                continue;
+            }
+            borderNormal /= borderLength;
+            float weight = glm::dot(edge, edge)*BORDER_WEIGHT;
+            for (uint32_t v: {a, b}) {
+                quadrics[v].addPlane(borderNormal, -glm::dot(borderNormal, positions[a]), weight);
+                quadrics[v].weight += weight;
+            }
+        }
+    }
+    auto getCost = [&](uint32_t from, uint32_t to) {
+        // `from` takes over the position and attributes of `to`, both quadrics apply there
+        const float* target = &attributes[to*ATTRIBUTE_COUNT];
+        float sum = quadrics[from].evaluate(positions[to], target) + quadrics[to].evaluate(positions[to], target);
+        float weight = quadrics[from].weight + quadrics[to].weight;
+        return weight > 0.0f ? std::max(sum, 0.0f)/weight : 0.0f;
+    };
+
+    // Passes of independent collapses, cheapest first. A vertex next to a collapse waits for the
+    // next pass, so the flip test of each collapse only sees triangles nothing else has moved.
+    float errorLimit = maxError*scale*maxError*scale;
+    float maxCost = 0.0f;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseTargets(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> firstTriangle(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    for (bool firstPass=true; result.size() > targetIndexCount; firstPass=false) {
+        if (!firstPass) {
+            collectHalfEdges();
+        }
+        collapses.clear();
+        for (size_t i=0; i<result.size(); i+=3) {
+            for (int corner=0; corner<3; corner++) {
+                uint32_t a = result[i + corner];
+                uint32_t b = result[i + (corner + 1)%3];
+                bool border = isBorder(a, b);
+                // interior edges come up again as b -> a from the triangle across
+                for (auto [from, to]: {std::pair{a, b}, std::pair{b, a}}) {
+                    if (from == b && !border) {
+                        break;
+                    }
+                    if (kinds[from] == VertexKind::Manifold || (kinds[from] == VertexKind::Border && border)) {
+                        collapses.push_back(Collapse{.from = from, .to = to, .cost = getCost(from, to)});
+                    }
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (uint32_t index: result) {
+            firstTriangle[index + 1]++;
+        }
+        for (size_t v=0; v<vertexCount; v++) {
+            firstTriangle[v + 1] += firstTriangle[v];
+        }
+        adjacency.resize(result.size());
+        std::vector<uint32_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i=0; i<result.size(); i++) {
+            adjacency[filled[result[i]]++] = (uint32_t)(i/3);
+        }
+
+        std::fill(touched.begin(), touched.end(), 0);
+        for (uint32_t v=0; v<vertexCount; v++) {
+            collapseTargets[v] = v;
+        }
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2)/3;
+        size_t removed = 0;
+        for (const Collapse& collapse: collapses) {
+            if (removed >= trianglesToRemove || collapse.cost > errorLimit) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            bool flips = false;
+            size_t sharedTriangles = 0;
+            for (uint32_t k=firstTriangle[collapse.from]; k<firstTriangle[collapse.from + 1] && !flips; k++) {
+                const uint32_t* triangle = &result[adjacency[k]*3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    sharedTriangles++;
+                    continue;
+                }
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (int corner=0; corner<3; corner++) {
+                    before[corner] = positions[triangle[corner]];
+                    after[corner] = triangle[corner] == collapse.from ? positions[collapse.to] : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= FLIP_THRESHOLD*glm::length(normalBefore)*glm::length(normalAfter);
+            }
+            if (flips) {
+                continue;
+            }
+            collapseTargets[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            maxCost = std::max(maxCost, collapse.cost);
+            removed += sharedTriangles;
+            for (uint32_t k=firstTriangle[collapse.from]; k<firstTriangle[collapse.from + 1]; k++) {
+                const uint32_t* triangle = &result[adjacency[k]*3];
+                touched[triangle[0]] = 1;
+                touched[triangle[1]] = 1;
+                touched[triangle[2]] = 1;
+            }
+        }
+        if (removed == 0) {
+            break;
+        }
+        size_t kept = 0;
+        for (size_t i=0; i<result.size(); i+=3) {
+            uint32_t a = collapseTargets[result[i]];
+            uint32_t b = collapseTargets[result[i + 1]];
+            uint32_t c = collapseTargets[result[i + 2]];
+            if (a != b && b != c && c != a) {
+                result[kept++] = a;
+                result[kept++] = b;
+                result[kept++] = c;
+            }
+        }
+        result.resize(kept);
+    }
+    error = std::sqrt(maxCost)*extent;
+    return result;
+}
+void buildLods(Mesh& mesh, MeshLoadStats& stats) {
+    mesh.lods.clear();
+    mesh.lodErrors.clear();
+    float sourceError = 0.0f;
+    while (mesh.lods.size() + 1 < MAX_MESH_LODS) {
+        const std::vector<uint32_t>& source = mesh.lods.empty() ? mesh.indices : mesh.lods.back();
+        if (source.size()/3 < MIN_LOD_TRIANGLES) {
+            break;
+        }
+        float error;
+        std::vector<uint32_t> lod = simplifyMesh(source, mesh.vertices, source.size()/6*3, std::numeric_limits<float>::max(), error);
+        if (lod.empty() || lod.size() > source.size()*MIN_LOD_REDUCTION) {
+            break;
+        }
+        optimizeVertexCache(lod, mesh.vertices.size());
+        // each level is simplified from the one before, so their errors add up
+        sourceError += error;
+        stats.lodTriangles += lod.size()/3;
+        mesh.lods.push_back(std::move(lod));
+        mesh.lodErrors.push_back(sourceError);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "config.hpp"
+#include "MeshLoader.hpp"
+
+// Import-time levels of detail by edge collapse. A vertex is only ever moved onto a neighbour,
+// so every level indexes the mesh's own vertices and only adds an index list to the packed buffers.
+
+// Collapses edges cheapest first until at most targetIndexCount indices are left or the next
+// collapse would cost more than maxError. The cost is the quadric error of the moved vertex plus
+// the attribute quadrics of normals and uvs, so collapses that distort shading stay expensive.
+// Vertices on uv or normal seams and on non-manifold edges are kept, open borders only slide
+// along themselves. `error` receives the largest error introduced, in mesh space units.
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+    size_t targetIndexCount, float maxError, float& error);
+// fills mesh.lods with up to MAX_MESH_LODS - 1 levels, each simplified from the one before to
+// about half its triangles and reordered for the post-transform cache
+void buildLods(Mesh& mesh, MeshLoadStats& stats);
@@ -0,0 +1,56 @@
+#include "MicroBench.hpp"
+#include "Profiler.hpp"
+
+bool MicroBench::parseArgs(int argc, char** argv, const std::string& countOption) {
+    for (int i=1; i+1<argc; i+=2) {
+        std::string arg = argv[i];
+        std::string value = argv[i+1];
+        if (arg == "--iterations") {
+            iterations = (uint32_t)std::stoul(value);
+        } else if (arg == "--threads") {
+            threadCount = (uint32_t)std::stoul(value);
+        } else if (arg == countOption) {
+            counts = {(size_t)std::stoull(value)};
+        } else if (arg == "--output") {
+            outputPath = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+void MicroBench::begin(const std::string& countName, const std::vector<std::string>& labelNames,
+    const std::string& resultName) {
+    pool.start(threadCount);
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        out = &file;
+    }
+    *out << countName;
+    for (const std::string& name: labelNames) {
+        *out << "," << name;
+    }
+    *out << ",threads,p50_ms,p95_ms,m" << countName << "_per_s," << resultName << std::endl;
+}
+BenchTiming MicroBench::time(const std::function<void()>& body, const std::function<void()>& setup) {
+    std::vector<double> ms;
+    for (uint32_t i=0; i<iterations; i++) {
+        if (setup) {
+            setup();
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        body();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return BenchTiming{.p50Ms = percentile(ms, 0.5), .p95Ms = percentile(ms, 0.95)};
+}
+void MicroBench::writeRow(size_t count, const std::vector<std::string>& labels, ThreadPool* threads, BenchTiming timing,
+    size_t result) {
+    *out << count;
+    for (const std::string& label: labels) {
+        *out << "," << label;
+    }
+    *out << "," << (threads ? threads->getThreadCount() : 1) << "," << timing.p50Ms << "," << timing.p95Ms << ","
+        << count/timing.p50Ms/1e3 << "," << result << std::endl;
+}
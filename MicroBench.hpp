@@ -0,0 +1,32 @@
+#pragma once
+#include "config.hpp"
+#include "ThreadPool.hpp"
+
+// Scaffolding shared by the device-free CPU benchmarks: the --iterations, --threads, --output and
+// problem size options, the worker pool, the CSV stream and the percentile timing loop. Each
+// bench only builds its inputs and names the variants it runs over every count.
+struct BenchTiming {
+    double p50Ms;
+    double p95Ms;
+};
+struct MicroBench {
+    // countOption takes one count in place of the 10k/100k/1M defaults; false after printing an
+    // unknown option
+    bool parseArgs(int argc, char** argv, const std::string& countOption);
+    // starts the pool and writes the header: count, labels, threads, p50_ms, p95_ms,
+    // m<count>_per_s and the bench's own result column
+    void begin(const std::string& countName, const std::vector<std::string>& labelNames, const std::string& resultName);
+    // setup runs before every iteration outside the timing
+    BenchTiming time(const std::function<void()>& body, const std::function<void()>& setup = nullptr);
+    // threads is the pool the variant ran on, nullptr for single threaded
+    void writeRow(size_t count, const std::vector<std::string>& labels, ThreadPool* threads, BenchTiming timing,
+        size_t result);
+
+    uint32_t iterations = 50;
+    uint32_t threadCount = std::thread::hardware_concurrency();
+    std::vector<size_t> counts = {10000, 100000, 1000000};
+    std::string outputPath;
+    ThreadPool pool;
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+};
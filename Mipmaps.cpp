@@ -0,0 +1,203 @@
+#include "Mipmaps.hpp"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// rows of the destination per job, enough to keep the pool busy on small levels too
+constexpr size_t MIP_ROWS_PER_CHUNK = 16;
+// destination rows filtered at once by the Kaiser kernel, bounds its row buffer
+constexpr uint32_t KAISER_BLOCK_ROWS = 32;
+constexpr int KAISER_TAPS = 6;
+
+void downsampleBoxRows(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, uint32_t dstWidth,
+    uint32_t rowBegin, uint32_t rowEnd) {
+    for (uint32_t y=rowBegin; y<rowEnd; y++) {
+        // a dimension of 1 has nothing to pair with and repeats its only row or column
+        const uint8_t* row0 = src + (size_t)std::min(2*y, height-1)*width*4;
+        const uint8_t* row1 = src + (size_t)std::min(2*y+1, height-1)*width*4;
+        uint8_t* out = dst + (size_t)y*dstWidth*4;
+        uint32_t x = 0;
+#if defined(__x86_64__)
+        // two destination pixels from four source pixels of each row
+        if (width >= 2) {
+            __m128i zero = _mm_setzero_si128();
+            __m128i two = _mm_set1_epi16(2);
+            for (; x+2<=dstWidth; x+=2) {
+                __m128i top = _mm_loadu_si128((const __m128i*)(row0 + x*8));
+                __m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + x*8));
+                // 16 bit sums of the two rows, pixels 0 and 1 in lo, 2 and 3 in hi
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+                __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+                _mm_storel_epi64((__m128i*)(out + x*4), _mm_packus_epi16(sum, sum));
+            }
+        }
+#endif
+        for (; x<dstWidth; x++) {
+            uint32_t x0 = std::min(2*x, width-1)*4;
+            uint32_t x1 = std::min(2*x+1, width-1)*4;
+            for (uint32_t c=0; c<4; c++) {
+                out[x*4+c] = (uint8_t)((row0[x0+c] + row0[x1+c] + row1[x0+c] + row1[x1+c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+// zeroth order modified Bessel function of the first kind, its series converges quickly for the window
+float besselI0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k=1; k<16; k++) {
+        term *= (x*0.5f/k)*(x*0.5f/k);
+        sum += term;
+    }
+    return sum;
+}
+// tap k sits at distance k - 2.5 source pixels from the destination pixel's center
+const std::array<float, KAISER_TAPS>& getKaiserWeights() {
+    static const std::array<float, KAISER_TAPS> weights = [] {
+        constexpr float alpha = 4.0f;
+        constexpr float radius = 3.0f;
+        constexpr float pi = 3.14159265f;
+        std::array<float, KAISER_TAPS> w;
+        float total = 0.0f;
+        for (int k=0; k<KAISER_TAPS; k++) {
+            // sinc at half the source rate, the cutoff of the halved level
+            float d = k - 2.5f;
+            float sinc = std::sin(pi*d*0.5f)/(pi*d*0.5f);
+            float window = besselI0(alpha*std::sqrt(1.0f - (d/radius)*(d/radius)))/besselI0(alpha);
+            w[k] = sinc*window;
+            total += w[k];
+        }
+        for (float& weight: w) {
+            weight /= total;
+        }
+        return w;
+    }();
+    return weights;
+}
+
+void downsampleKaiserRows(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, uint32_t dstWidth,
+    uint32_t rowBegin, uint32_t rowEnd) {
+    const std::array<float, KAISER_TAPS>& weights = getKaiserWeights();
+    // taps start two pixels before the pair a destination pixel covers, clamped at the edges
+    auto clampIndex = [](int64_t i, uint32_t size) { return (uint32_t)std::clamp<int64_t>(i, 0, (int64_t)size - 1); };
+    // the source rows of one block filtered horizontally, 4 floats per pixel
+    std::vector<float> rows;
+    for (uint32_t blockBegin=rowBegin; blockBegin<rowEnd; blockBegin+=KAISER_BLOCK_ROWS) {
+        uint32_t blockEnd = std::min(blockBegin + KAISER_BLOCK_ROWS, rowEnd);
+        int64_t firstRow = (int64_t)blockBegin*2 - 2;
+        uint32_t rowCount = (blockEnd - blockBegin)*2 + KAISER_TAPS - 2;
+        rows.resize((size_t)rowCount*dstWidth*4);
+        for (uint32_t r=0; r<rowCount; r++) {
+            const uint8_t* in = src + (size_t)clampIndex(firstRow + r, height)*width*4;
+            float* out = rows.data() + (size_t)r*dstWidth*4;
+            for (uint32_t x=0; x<dstWidth; x++) {
+#if defined(__x86_64__)
+                __m128 sum = _mm_setzero_ps();
+                for (int k=0; k<KAISER_TAPS; k++) {
+                    uint32_t px;
+                    memcpy(&px, in + clampIndex((int64_t)x*2 - 2 + k, width)*4, sizeof(px));
+                    __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)px), _mm_setzero_si128());
+                    __m128 pixel = _mm_cvtepi32_ps(_mm_unpacklo_epi16(wide, _mm_setzero_si128()));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(weights[k])));
+                }
+                _mm_storeu_ps(out + x*4, sum);
+#else
+                float sum[4] = {};
+                for (int k=0; k<KAISER_TAPS; k++) {
+                    const uint8_t* pixel = in + clampIndex((int64_t)x*2 - 2 + k, width)*4;
+                    for (int c=0; c<4; c++) {
+                        sum[c] += pixel[c]*weights[k];
+                    }
+                }
+                memcpy(out + x*4, sum, sizeof(sum));
+#endif
+            }
+        }
+        for (uint32_t y=blockBegin; y<blockEnd; y++) {
+            // destination row y starts at source row 2y - 2, the block's rows start at 2*blockBegin - 2
+            const float* taps = rows.data() + (size_t)(y - blockBegin)*2*dstWidth*4;
+            uint8_t* out = dst + (size_t)y*dstWidth*4;
+            for (uint32_t x=0; x<dstWidth; x++) {
+#if defined(__x86_64__)
+                __m128 sum = _mm_setzero_ps();
+                for (int k=0; k<KAISER_TAPS; k++) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(taps + ((size_t)k*dstWidth + x)*4), _mm_set1_ps(weights[k])));
+                }
+                // rounds to nearest, the negative lobes can push a channel out of range on either side
+                __m128i value = _mm_cvtps_epi32(sum);
+                value = _mm_packs_epi32(value, value);
+                int packed = _mm_cvtsi128_si32(_mm_packus_epi16(value, value));
+                memcpy(out + x*4, &packed, sizeof(packed));
+#else
+                for (int c=0; c<4; c++) {
+                    float sum = 0.0f;
+                    for (int k=0; k<KAISER_TAPS; k++) {
+                        sum += taps[((size_t)k*dstWidth + x)*4 + c]*weights[k];
+                    }
+                    out[x*4+c] = (uint8_t)std::clamp(std::lround(sum), 0l, 255l);
+                }
+#endif
+            }
+        }
+    }
+}
+
+}
+
+const char* getMipFilterName(MipFilter filter) {
+    switch (filter) {
+    case MipFilter::Box:
+        return "box";
+    case MipFilter::Kaiser:
+        return "kaiser";
+    }
+    return "unknown";
+}
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size=std::max(width, height); size>1; size/=2) {
+        levels++;
+    }
+    return levels;
+}
+
+void downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, MipFilter filter, ThreadPool* pool) {
+    uint32_t dstWidth = std::max(width/2, 1u);
+    uint32_t dstHeight = std::max(height/2, 1u);
+    auto job = [&](size_t begin, size_t end) {
+        if (filter == MipFilter::Box) {
+            downsampleBoxRows(src, width, height, dst, dstWidth, (uint32_t)begin, (uint32_t)end);
+        } else {
+            downsampleKaiserRows(src, width, height, dst, dstWidth, (uint32_t)begin, (uint32_t)end);
+        }
+    };
+    if (pool == nullptr) {
+        job(0, dstHeight);
+        return;
+    }
+    pool->parallelFor(dstHeight, MIP_ROWS_PER_CHUNK, job);
+}
+
+std::vector<MipLevel> generateMipChain(const void* pixels, uint32_t width, uint32_t height, MipFilter filter,
+    ThreadPool* pool) {
+    uint32_t levelCount = getMipLevelCount(width, height);
+    std::vector<MipLevel> levels(levelCount - 1);
+    const uint8_t* src = static_cast<const uint8_t*>(pixels);
+    for (uint32_t level=1; level<levelCount; level++) {
+        MipLevel& mip = levels[level-1];
+        mip.width = std::max(width/2, 1u);
+        mip.height = std::max(height/2, 1u);
+        mip.pixels.resize((size_t)mip.width*mip.height*4);
+        downsample(src, width, height, mip.pixels.data(), filter, pool);
+        src = mip.pixels.data();
+        width = mip.width;
+        height = mip.height;
+    }
+    return levels;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "config.hpp"
+#include "ThreadPool.hpp"
+
+// CPU mip chain generation for RGBA8 images, for formats the GPU can't blit with linear filtering
+// and for baking textures offline. Every level halves the one before, rounding down, and is
+// filtered from it; the rows of a level are split across a ThreadPool when one is given.
+enum class MipFilter {
+    // 2x2 average, what a linear blit computes
+    Box,
+    // separable 6 tap Kaiser-windowed sinc, keeps more detail than the box without ringing much
+    Kaiser
+};
+const char* getMipFilterName(MipFilter filter);
+
+// levels down to 1x1, floor(log2(max(width, height))) + 1
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+struct MipLevel {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+};
+// levels 1 to getMipLevelCount() - 1, level 0 is the input itself
+std::vector<MipLevel> generateMipChain(const void* pixels, uint32_t width, uint32_t height, MipFilter filter,
+    ThreadPool* pool = nullptr);
+// one level: dst is max(width/2, 1) x max(height/2, 1) pixels
+void downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, MipFilter filter,
+    ThreadPool* pool = nullptr);
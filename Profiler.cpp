@@ -0,0 +1,142 @@
+#include "Profiler.hpp"
+
+void Profiler::init(VkDevice dev, VkPhysicalDevice pDevice, uint32_t gfxFamily, uint32_t frameCount) {
+    device = dev;
+    events.resize(EVENT_CAPACITY);
+
+    uint32_t count;
+    vkGetPhysicalDeviceQueueFamilyProperties(pDevice, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> queues(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(pDevice, &count, queues.data());
+    if (queues[gfxFamily].timestampValidBits == 0) {
+        return;
+    }
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(pDevice, &props);
+    timestampPeriod = props.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolCI{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = (MAX_GPU_ZONES+1)*2,
+        .pipelineStatistics = 0
+    };
+    queryPools.resize(frameCount);
+    for (auto& queryPool: queryPools) {
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolCI, nullptr, &queryPool));
+    }
+    gpuZones.resize(frameCount);
+    gpuFrameCpuNs.assign(frameCount, 0);
+    gpuFrameTimed.assign(frameCount, false);
+}
+void Profiler::destroy() {
+    for (auto& queryPool: queryPools) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+    }
+    queryPools.clear();
+}
+uint64_t Profiler::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+void Profiler::addCpuEvent(const char* name, uint64_t startNs, uint64_t endNs) {
+    events[eventHead] = ProfileEvent{
+        .name = name,
+        .startNs = startNs,
+        .durationNs = endNs - startNs,
+        .track = 0
+    };
+    eventHead = (eventHead+1)%EVENT_CAPACITY;
+    eventCount = std::min(eventCount+1, EVENT_CAPACITY);
+
+    ProfileSamples& window = samples[name];
+    double ms = (endNs - startNs)/1e6;
+    if (window.ms.size() < SAMPLE_WINDOW) {
+        window.ms.push_back(ms);
+    } else {
+        window.ms[window.next] = ms;
+    }
+    window.next = (window.next+1)%SAMPLE_WINDOW;
+}
+void Profiler::beginGpuFrame(VkCommandBuffer& cmdBuffer, uint32_t frame, uint64_t cpuSubmitNs) {
+    if (queryPools.empty()) {
+        return;
+    }
+    gpuZones[frame].clear();
+    gpuFrameCpuNs[frame] = cpuSubmitNs;
+    vkCmdResetQueryPool(cmdBuffer, queryPools[frame], 0, (MAX_GPU_ZONES+1)*2);
+    vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_NONE, queryPools[frame], 0);
+}
+void Profiler::endGpuFrame(VkCommandBuffer& cmdBuffer, uint32_t frame) {
+    if (queryPools.empty()) {
+        return;
+    }
+    vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPools[frame], 1);
+    gpuFrameTimed[frame] = true;
+}
+uint32_t Profiler::beginGpuZone(VkCommandBuffer& cmdBuffer, uint32_t frame, const char* name) {
+    if (queryPools.empty() || gpuZones[frame].size() == MAX_GPU_ZONES) {
+        return UINT32_MAX;
+    }
+    uint32_t zone = (uint32_t)gpuZones[frame].size();
+    gpuZones[frame].push_back(GpuZone{.name = name, .query = 2 + zone*2});
+    vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPools[frame], 2 + zone*2);
+    return zone;
+}
+void Profiler::endGpuZone(VkCommandBuffer& cmdBuffer, uint32_t frame, uint32_t zone) {
+    vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPools[frame], 2 + zone*2+1);
+}
+std::optional<double> Profiler::collectGpuFrame(uint32_t frame) {
+    // only called once the frame's timeline value is reached, so the results are available
+    if (queryPools.empty() || !gpuFrameTimed[frame]) {
+        return std::nullopt;
+    }
+    gpuFrameTimed[frame] = false;
+    std::vector<GpuZone>& zones = gpuZones[frame];
+    std::vector<uint64_t> timestamps(2 + zones.size()*2);
+    VK_CHECK(vkGetQueryPoolResults(device, queryPools[frame], 0, (uint32_t)timestamps.size(), 
+        timestamps.size()*sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+    double frameMs = (timestamps[1]-timestamps[0])*timestampPeriod/1e6;
+    if (zones.empty()) {
+        return frameMs;
+    }
+    if (!gpuClockOffsetNs.has_value()) {
+        gpuClockOffsetNs = (int64_t)gpuFrameCpuNs[frame] - (int64_t)(timestamps[0]*timestampPeriod);
+    }
+    for (const auto& zone: zones) {
+        uint64_t startNs = (uint64_t)(timestamps[zone.query]*timestampPeriod + gpuClockOffsetNs.value());
+        uint64_t endNs = (uint64_t)(timestamps[zone.query+1]*timestampPeriod + gpuClockOffsetNs.value());
+        addCpuEvent(zone.name, startNs, endNs);
+        events[(eventHead+EVENT_CAPACITY-1)%EVENT_CAPACITY].track = 1;
+    }
+    zones.clear();
+    return frameMs;
+}
+void Profiler::writeChromeTrace(std::string path) {
+    std::ofstream file(path);
+    file << "{\"traceEvents\":[\n";
+    size_t first = (eventHead+EVENT_CAPACITY-eventCount)%EVENT_CAPACITY;
+    for (size_t i=0; i<eventCount; i++) {
+        const ProfileEvent& event = events[(first+i)%EVENT_CAPACITY];
+        file << (i==0 ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.track 
+            << ",\"ts\":" << event.startNs/1000.0 << ",\"dur\":" << event.durationNs/1000.0 << "}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+void Profiler::printStats() {
+    for (const auto& [name, window]: samples) {
+        std::cout << name << ": p50 " << percentile(window.ms, 0.5) << " ms, p95 " << percentile(window.ms, 0.95) 
+            << " ms, p99 " << percentile(window.ms, 0.99) << " ms" << std::endl;
+    }
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(values.size()-1, (size_t)(p*values.size()));
+    std::nth_element(values.begin(), values.begin()+index, values.end());
+    return values[index];
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+    // 0 for CPU scopes, 1 for GPU zones
+    uint32_t track;
+};
+struct ProfileSamples {
+    std::vector<double> ms;
+    size_t next = 0;
+};
+struct GpuZone {
+    const char* name;
+    uint32_t query;
+};
+
+// CPU scopes and GPU timestamp zones recorded into a fixed ring of events. Everything is
+// gated on `enabled` so a compiled-in but disabled profiler costs one branch per marker,
+// except the GPU frame timer: queries 0 and 1 of each frame's pool bracket the whole frame
+// on every frame, the zones follow them.
+struct Profiler {
+    void init(VkDevice dev, VkPhysicalDevice pDevice, uint32_t gfxFamily, uint32_t frameCount);
+    void destroy();
+    void addCpuEvent(const char* name, uint64_t startNs, uint64_t endNs);
+    void beginGpuFrame(VkCommandBuffer& cmdBuffer, uint32_t frame, uint64_t cpuSubmitNs);
+    void endGpuFrame(VkCommandBuffer& cmdBuffer, uint32_t frame);
+    uint32_t beginGpuZone(VkCommandBuffer& cmdBuffer, uint32_t frame, const char* name);
+    void endGpuZone(VkCommandBuffer& cmdBuffer, uint32_t frame, uint32_t zone);
+    // GPU time of the frame in ms, nullopt when it wasn't timed or was already collected
+    std::optional<double> collectGpuFrame(uint32_t frame);
+    void writeChromeTrace(std::string path);
+    void printStats();
+    static uint64_t nowNs();
+
+    static constexpr size_t EVENT_CAPACITY = 1<<16;
+    static constexpr size_t SAMPLE_WINDOW = 512;
+    static constexpr uint32_t MAX_GPU_ZONES = 16;
+
+    bool enabled = false;
+    VkDevice device = VK_NULL_HANDLE;
+    std::vector<ProfileEvent> events;
+    size_t eventHead = 0;
+    size_t eventCount = 0;
+    // keyed by the marker's string literal, so lookups never hash the text
+    std::unordered_map<const char*, ProfileSamples> samples;
+    std::vector<VkQueryPool> queryPools;
+    std::vector<std::vector<GpuZone>> gpuZones;
+    std::vector<uint64_t> gpuFrameCpuNs;
+    std::vector<bool> gpuFrameTimed;
+    double timestampPeriod = 0.0;
+    // maps GPU ticks onto the CPU clock, taken from the first collected frame
+    std::optional<int64_t> gpuClockOffsetNs;
+};
+
+struct ProfileScope {
+    ProfileScope(Profiler& owner, const char* scopeName) : profiler(owner), name(scopeName) {
+        if (profiler.enabled) {
+            startNs = Profiler::nowNs();
+        }
+    }
+    ~ProfileScope() {
+        if (profiler.enabled && startNs != 0) {
+            profiler.addCpuEvent(name, startNs, Profiler::nowNs());
+        }
+    }
+    Profiler& profiler;
+    const char* name;
+    uint64_t startNs = 0;
+};
+
+struct GpuProfileScope {
+    GpuProfileScope(Profiler& owner, VkCommandBuffer& cmd, uint32_t frameIndex, const char* name) 
+        : profiler(owner), cmdBuffer(cmd), frame(frameIndex) {
+        if (profiler.enabled) {
+            zone = profiler.beginGpuZone(cmdBuffer, frame, name);
+        }
+    }
+    ~GpuProfileScope() {
+        if (zone != UINT32_MAX) {
+            profiler.endGpuZone(cmdBuffer, frame, zone);
+        }
+    }
+    Profiler& profiler;
+    VkCommandBuffer& cmdBuffer;
+    uint32_t frame;
+    uint32_t zone = UINT32_MAX;
+};
+
+double percentile(std::vector<double> values, double p);
+
+#ifdef ENGINE_PROFILER
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(profiler, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(profiler, name)
+#define PROFILE_GPU_SCOPE(profiler, cmdBuffer, frame, name) \
+    GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, cmdBuffer, frame, name)
+#else
+#define PROFILE_SCOPE(profiler, name)
+#define PROFILE_GPU_SCOPE(profiler, cmdBuffer, frame, name)
+#endif
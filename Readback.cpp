@@ -0,0 +1,72 @@
+#include "Readback.hpp"
+
+void ReadbackWorker::start(ReadbackCallback consumer, uint32_t slotCount) {
+    callback = consumer;
+    slotBusy.assign(slotCount, false);
+    stopping = false;
+    thread = std::thread(&ReadbackWorker::work, this);
+}
+void ReadbackWorker::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queueChanged.notify_one();
+    thread.join();
+}
+void ReadbackWorker::submit(uint32_t slot, ReadbackFrame frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slotBusy[slot] = true;
+        queue.emplace_back(slot, frame);
+    }
+    queueChanged.notify_one();
+}
+void ReadbackWorker::waitSlotFree(uint32_t slot) {
+    std::unique_lock<std::mutex> lock(mutex);
+    slotReleased.wait(lock, [&] { return !slotBusy[slot]; });
+}
+void ReadbackWorker::work() {
+    while (true) {
+        std::pair<uint32_t, ReadbackFrame> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock, [&] { return stopping || !queue.empty(); });
+            // drain what was already queued before shutting down
+            if (queue.empty()) {
+                return;
+            }
+            job = queue.front();
+            queue.pop_front();
+        }
+        callback(job.second);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slotBusy[job.first] = false;
+        }
+        slotReleased.notify_all();
+    }
+}
+
+ReadbackCallback createPPMSink(std::string directory) {
+    return [directory](const ReadbackFrame& frame) {
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%06llu.ppm", (unsigned long long)frame.frameNumber);
+        std::ofstream file(directory + name, std::ios::binary);
+        file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+        bool bgr = frame.format == VK_FORMAT_B8G8R8A8_UNORM || frame.format == VK_FORMAT_B8G8R8A8_SRGB;
+        std::vector<uint8_t> row(frame.width*3);
+        for (uint32_t y=0; y<frame.height; y++) {
+            const uint8_t* src = frame.pixels + (size_t)y*frame.width*4;
+            for (uint32_t x=0; x<frame.width; x++) {
+                row[x*3+0] = src[x*4 + (bgr ? 2 : 0)];
+                row[x*3+1] = src[x*4+1];
+                row[x*3+2] = src[x*4 + (bgr ? 0 : 2)];
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), row.size());
+        }
+    };
+}
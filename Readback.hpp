@@ -0,0 +1,33 @@
+#pragma once
+#include "config.hpp"
+
+struct ReadbackFrame {
+    uint64_t frameNumber;
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    // tightly packed rows of 4 byte texels, only valid for the duration of the callback
+    const uint8_t* pixels;
+};
+using ReadbackCallback = std::function<void(const ReadbackFrame&)>;
+
+// Hands completed readback slots to a consumer on its own thread. A slot stays busy until
+// the consumer returns, so the renderer only blocks when the consumer falls a full ring behind.
+struct ReadbackWorker {
+    void start(ReadbackCallback consumer, uint32_t slotCount);
+    void stop();
+    void submit(uint32_t slot, ReadbackFrame frame);
+    void waitSlotFree(uint32_t slot);
+    void work();
+
+    ReadbackCallback callback;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::condition_variable slotReleased;
+    std::deque<std::pair<uint32_t, ReadbackFrame>> queue;
+    std::vector<bool> slotBusy;
+    bool stopping = false;
+};
+
+ReadbackCallback createPPMSink(std::string directory);
@@ -0,0 +1,417 @@
+#include "RenderGraph.hpp"
+
+static constexpr VkPipelineStageFlags2 SHADER_STAGES = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+
+UsageInfo getUsageInfo(ResourceUsage usage) {
+    switch (usage) {
+    case ResourceUsage::ColorAttachment:
+        return UsageInfo{VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+    case ResourceUsage::DepthAttachment:
+        return UsageInfo{VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, true};
+    case ResourceUsage::Sampled:
+        return UsageInfo{SHADER_STAGES, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case ResourceUsage::StorageRead:
+        return UsageInfo{SHADER_STAGES, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false};
+    case ResourceUsage::StorageWrite:
+        return UsageInfo{SHADER_STAGES, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, true};
+    case ResourceUsage::TransferSrc:
+        return UsageInfo{VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+    case ResourceUsage::TransferDst:
+        return UsageInfo{VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+    case ResourceUsage::IndirectRead:
+        return UsageInfo{VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::VertexRead:
+        return UsageInfo{VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::IndexRead:
+        return UsageInfo{VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::UniformRead:
+        return UsageInfo{SHADER_STAGES, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::HostRead:
+        return UsageInfo{VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::Present:
+        // the present engine waits on a semaphore, nothing in the pipeline follows
+        return UsageInfo{VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false};
+    }
+    throw std::runtime_error("VK Error: unknown resource usage");
+}
+UsageInfo getLayoutUsageInfo(VkImageLayout layout) {
+    switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+        return UsageInfo{VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case VK_IMAGE_LAYOUT_GENERAL:
+        return UsageInfo{VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, true};
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+        return getUsageInfo(ResourceUsage::ColorAttachment);
+    case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL:
+        return getUsageInfo(ResourceUsage::DepthAttachment);
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        return getUsageInfo(ResourceUsage::Sampled);
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        return getUsageInfo(ResourceUsage::TransferSrc);
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        return getUsageInfo(ResourceUsage::TransferDst);
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+        return getUsageInfo(ResourceUsage::Present);
+    default:
+        throw std::runtime_error(std::string("VK Error: no transition scope for layout ") + string_VkImageLayout(layout));
+    }
+}
+
+uint32_t RenderGraph::importImage(const char* name, VkImageAspectFlags aspectMask, VkImageLayout initialLayout,
+    VkPipelineStageFlags2 initialStage, std::optional<ResourceUsage> finalUsage) {
+    Image image{
+        .name = name,
+        .imported = true,
+        .desc = ImageDesc{.format = VK_FORMAT_UNDEFINED, .extent = {}, .usage = 0, .samples = VK_SAMPLE_COUNT_1_BIT, .aspectMask = aspectMask},
+        .finalUsage = finalUsage
+    };
+    // whatever happened to the image before the graph runs is only known by its stage
+    image.initialState = ResourceState{
+        .layout = initialLayout,
+        .writeStage = initialStage,
+        .writeAccess = VK_ACCESS_2_NONE,
+        .readStages = VK_PIPELINE_STAGE_2_NONE,
+        .dirty = true
+    };
+    images.push_back(image);
+    return (uint32_t)images.size()-1;
+}
+void RenderGraph::setImportedImage(uint32_t handle, VkImage image, VkImageView view) {
+    images[handle].image = image;
+    images[handle].view = view;
+}
+uint32_t RenderGraph::createImage(const char* name, ImageDesc desc) {
+    images.push_back(Image{.name = name, .imported = false, .desc = desc});
+    return (uint32_t)images.size()-1;
+}
+uint32_t RenderGraph::importBuffer(const char* name, std::optional<ResourceUsage> finalUsage) {
+    buffers.push_back(Buffer{.name = name, .buffer = VK_NULL_HANDLE, .finalUsage = finalUsage});
+    return (uint32_t)buffers.size()-1;
+}
+void RenderGraph::setImportedBuffer(uint32_t handle, VkBuffer buffer) {
+    buffers[handle].buffer = buffer;
+}
+uint32_t RenderGraph::addPass(const char* name, std::function<void(VkCommandBuffer&)> record, bool sideEffect) {
+    passes.push_back(Pass{.name = name, .record = record, .sideEffect = sideEffect});
+    return (uint32_t)passes.size()-1;
+}
+void RenderGraph::useImage(uint32_t pass, uint32_t image, ResourceUsage usage) {
+    passes[pass].uses.push_back(Use{.resource = image, .image = true, .usage = usage});
+}
+void RenderGraph::useBuffer(uint32_t pass, uint32_t buffer, ResourceUsage usage) {
+    passes[pass].uses.push_back(Use{.resource = buffer, .image = false, .usage = usage});
+}
+void RenderGraph::compile(VkDevice dev, MemoryAllocator& memAllocator) {
+    device = dev;
+    allocator = &memAllocator;
+    cullPasses();
+    allocateTransients();
+    buildBarriers();
+}
+void RenderGraph::cullPasses() {
+    // walk backwards from what leaves the graph: imported resources and side effects
+    std::vector<bool> neededImages(images.size());
+    std::vector<bool> neededBuffers(buffers.size(), true);
+    for (uint32_t i=0; i<images.size(); i++) {
+        neededImages[i] = images[i].imported;
+    }
+    culledPassCount = 0;
+    for (uint32_t p=(uint32_t)passes.size(); p-- > 0;) {
+        Pass& pass = passes[p];
+        bool alive = pass.sideEffect;
+        for (const auto& use: pass.uses) {
+            if (getUsageInfo(use.usage).write && (use.image ? neededImages[use.resource] : neededBuffers[use.resource])) {
+                alive = true;
+            }
+        }
+        pass.culled = !alive;
+        if (!alive) {
+            culledPassCount++;
+            continue;
+        }
+        for (const auto& use: pass.uses) {
+            if (use.image) {
+                neededImages[use.resource] = true;
+            }
+        }
+    }
+}
+void RenderGraph::allocateTransients() {
+    std::vector<uint32_t> transients;
+    for (uint32_t p=0; p<passes.size(); p++) {
+        if (passes[p].culled) {
+            continue;
+        }
+        for (const auto& use: passes[p].uses) {
+            Image& image = images[use.resource];
+            if (!use.image || image.imported) {
+                continue;
+            }
+            if (image.firstPass == UINT32_MAX) {
+                transients.push_back(use.resource);
+            }
+            image.firstPass = std::min(image.firstPass, p);
+            image.lastPass = std::max(image.lastPass, p);
+        }
+    }
+    // first fit over slots in lifetime order; an image may take a slot whose last user is done
+    transientBytes = 0;
+    aliasedBytes = 0;
+    for (uint32_t index: transients) {
+        Image& image = images[index];
+        VkImageCreateInfo imageCI{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = image.desc.format,
+            .extent = VkExtent3D{.width = image.desc.extent.width, .height = image.desc.extent.height, .depth = 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = image.desc.samples,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = image.desc.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VK_CHECK(vkCreateImage(device, &imageCI, nullptr, &image.image));
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image.image, &memRequirements);
+        transientBytes += memRequirements.size;
+        for (uint32_t s=0; s<slots.size(); s++) {
+            Slot& slot = slots[s];
+            if (slot.lastPass < image.firstPass && (slot.memRequirements.memoryTypeBits & memRequirements.memoryTypeBits)) {
+                slot.memRequirements.size = std::max(slot.memRequirements.size, memRequirements.size);
+                slot.memRequirements.alignment = std::max(slot.memRequirements.alignment, memRequirements.alignment);
+                slot.memRequirements.memoryTypeBits &= memRequirements.memoryTypeBits;
+                slot.lastPass = image.lastPass;
+                image.slot = s;
+                aliasedBytes += memRequirements.size;
+                break;
+            }
+        }
+        if (image.slot == UINT32_MAX) {
+            slots.push_back(Slot{.memRequirements = memRequirements, .lastPass = image.lastPass, .memory = {}});
+            image.slot = (uint32_t)slots.size()-1;
+        }
+    }
+    for (auto& slot: slots) {
+        slot.memory = allocator->allocate(slot.memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, false,
+            VK_NULL_HANDLE, VK_NULL_HANDLE);
+    }
+    // every image sharing a slot, and the previous frame's use of the image itself, may still
+    // be in flight when the image is first touched, so its first barrier waits for all of them
+    std::vector<ResourceState> slotStates(slots.size(), ResourceState{.dirty = true});
+    for (const auto& pass: passes) {
+        for (const auto& use: pass.uses) {
+            if (!use.image || images[use.resource].imported || pass.culled) {
+                continue;
+            }
+            UsageInfo info = getUsageInfo(use.usage);
+            ResourceState& state = slotStates[images[use.resource].slot];
+            state.writeStage |= info.stage;
+            state.writeAccess |= info.write ? info.access : VK_ACCESS_2_NONE;
+        }
+    }
+    for (uint32_t index: transients) {
+        Image& image = images[index];
+        VK_CHECK(vkBindImageMemory(device, image.image, slots[image.slot].memory.memory, slots[image.slot].memory.offset));
+        VkImageViewCreateInfo imageViewCI{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .image = image.image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = image.desc.format,
+            .components{
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+            .subresourceRange{
+                .aspectMask = image.desc.aspectMask,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        VK_CHECK(vkCreateImageView(device, &imageViewCI, nullptr, &image.view));
+        image.initialState = slotStates[image.slot];
+    }
+}
+bool RenderGraph::addBarrier(ResourceState& state, ResourceUsage usage, bool image, VkPipelineStageFlags2& srcStage,
+    VkAccessFlags2& srcAccess, VkImageLayout& oldLayout) {
+    UsageInfo info = getUsageInfo(usage);
+    bool layoutChange = image && state.layout != info.layout;
+    bool unsyncedRead = state.dirty && (info.stage & ~state.readStages) != 0;
+    if (!layoutChange && !info.write && !unsyncedRead) {
+        state.readStages |= info.stage;
+        return false;
+    }
+    oldLayout = state.layout;
+    // writes and layout transitions also have to wait for the readers of the old contents
+    srcStage = (info.write || layoutChange) ? state.writeStage | state.readStages : state.writeStage;
+    srcAccess = state.writeAccess;
+    if (info.write) {
+        state.writeStage = info.stage;
+        state.writeAccess = info.access;
+        state.readStages = VK_PIPELINE_STAGE_2_NONE;
+    } else if (layoutChange) {
+        // later readers in other stages have to wait for the transition, which finishes before info.stage
+        state.writeStage = info.stage;
+        state.writeAccess = VK_ACCESS_2_NONE;
+        state.readStages = info.stage;
+    } else {
+        state.readStages |= info.stage;
+    }
+    if (image) {
+        state.layout = info.layout;
+    }
+    state.dirty = true;
+    return true;
+}
+void RenderGraph::buildPassBarriers(Pass& pass, const std::vector<Use>& uses, std::vector<ResourceState>& imageStates,
+    std::vector<ResourceState>& bufferStates) {
+    pass.imageBarriers.clear();
+    pass.imageBarrierResources.clear();
+    pass.bufferBarriers.clear();
+    pass.bufferBarrierResources.clear();
+    for (const auto& use: uses) {
+        UsageInfo info = getUsageInfo(use.usage);
+        VkPipelineStageFlags2 srcStage;
+        VkAccessFlags2 srcAccess;
+        VkImageLayout oldLayout;
+        if (use.image) {
+            if (!addBarrier(imageStates[use.resource], use.usage, true, srcStage, srcAccess, oldLayout)) {
+                continue;
+            }
+            pass.imageBarriers.push_back(VkImageMemoryBarrier2{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .pNext = nullptr,
+                .srcStageMask = srcStage,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = info.stage,
+                .dstAccessMask = info.access,
+                .oldLayout = oldLayout,
+                .newLayout = info.layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = VK_NULL_HANDLE,
+                .subresourceRange{
+                    .aspectMask = images[use.resource].desc.aspectMask,
+                    .baseMipLevel = 0,
+                    .levelCount = VK_REMAINING_MIP_LEVELS,
+                    .baseArrayLayer = 0,
+                    .layerCount = VK_REMAINING_ARRAY_LAYERS
+                }
+            });
+            pass.imageBarrierResources.push_back(use.resource);
+        } else {
+            if (!addBarrier(bufferStates[use.resource], use.usage, false, srcStage, srcAccess, oldLayout)) {
+                continue;
+            }
+            pass.bufferBarriers.push_back(VkBufferMemoryBarrier2{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                .pNext = nullptr,
+                .srcStageMask = srcStage,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = info.stage,
+                .dstAccessMask = info.access,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = VK_NULL_HANDLE,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE
+            });
+            pass.bufferBarrierResources.push_back(use.resource);
+        }
+    }
+}
+void RenderGraph::buildBarriers() {
+    std::vector<ResourceState> imageStates(images.size());
+    std::vector<ResourceState> bufferStates(buffers.size());
+    for (uint32_t i=0; i<images.size(); i++) {
+        imageStates[i] = images[i].initialState;
+    }
+    for (auto& pass: passes) {
+        if (!pass.culled) {
+            buildPassBarriers(pass, pass.uses, imageStates, bufferStates);
+        }
+    }
+    std::vector<Use> finalUses;
+    for (uint32_t i=0; i<images.size(); i++) {
+        if (images[i].finalUsage.has_value()) {
+            finalUses.push_back(Use{.resource = i, .image = true, .usage = images[i].finalUsage.value()});
+        }
+    }
+    for (uint32_t i=0; i<buffers.size(); i++) {
+        if (buffers[i].finalUsage.has_value()) {
+            finalUses.push_back(Use{.resource = i, .image = false, .usage = buffers[i].finalUsage.value()});
+        }
+    }
+    buildPassBarriers(finalBarriers, finalUses, imageStates, bufferStates);
+}
+void RenderGraph::recordBarriers(Pass& pass, VkCommandBuffer& cmdBuffer) {
+    if (pass.imageBarriers.empty() && pass.bufferBarriers.empty()) {
+        return;
+    }
+    for (uint32_t i=0; i<pass.imageBarriers.size(); i++) {
+        pass.imageBarriers[i].image = images[pass.imageBarrierResources[i]].image;
+    }
+    for (uint32_t i=0; i<pass.bufferBarriers.size(); i++) {
+        pass.bufferBarriers[i].buffer = buffers[pass.bufferBarrierResources[i]].buffer;
+    }
+    VkDependencyInfo dependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = (uint32_t)pass.bufferBarriers.size(),
+        .pBufferMemoryBarriers = pass.bufferBarriers.data(),
+        .imageMemoryBarrierCount = (uint32_t)pass.imageBarriers.size(),
+        .pImageMemoryBarriers = pass.imageBarriers.data()
+    };
+    vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+}
+void RenderGraph::execute(VkCommandBuffer& cmdBuffer) {
+    for (auto& pass: passes) {
+        if (pass.culled) {
+            continue;
+        }
+        recordBarriers(pass, cmdBuffer);
+        pass.record(cmdBuffer);
+    }
+    recordBarriers(finalBarriers, cmdBuffer);
+}
+void RenderGraph::reset() {
+    for (auto& image: images) {
+        if (!image.imported && image.image != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, image.view, nullptr);
+            vkDestroyImage(device, image.image, nullptr);
+        }
+    }
+    for (auto& slot: slots) {
+        allocator->free(slot.memory);
+    }
+    images.clear();
+    buffers.clear();
+    passes.clear();
+    slots.clear();
+    finalBarriers.imageBarriers.clear();
+    finalBarriers.bufferBarriers.clear();
+    culledPassCount = 0;
+    transientBytes = 0;
+    aliasedBytes = 0;
+}
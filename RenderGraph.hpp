@@ -0,0 +1,129 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+#include "Allocator.hpp"
+
+enum class ResourceUsage {
+    ColorAttachment,
+    DepthAttachment,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+    IndirectRead,
+    VertexRead,
+    IndexRead,
+    UniformRead,
+    HostRead,
+    Present
+};
+struct UsageInfo {
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    bool write;
+};
+UsageInfo getUsageInfo(ResourceUsage usage);
+// scope of an image sitting in `layout`, for one-off transitions outside the graph
+UsageInfo getLayoutUsageInfo(VkImageLayout layout);
+
+// Passes declare the images and buffers they touch, compile() culls passes nothing depends on,
+// turns the declared usages into one batch of barriers per pass and places transient images
+// with disjoint lifetimes in the same memory. The compiled graph is executed every frame,
+// imported resources may be swapped between executions.
+struct RenderGraph {
+    struct ImageDesc {
+        VkFormat format;
+        VkExtent2D extent;
+        VkImageUsageFlags usage;
+        VkSampleCountFlagBits samples;
+        VkImageAspectFlags aspectMask;
+    };
+    struct ResourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 writeStage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+        // stages that already read the current contents, or were made to wait for them
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+        bool dirty = false;
+    };
+    struct Image {
+        const char* name;
+        bool imported;
+        ImageDesc desc;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        ResourceState initialState;
+        std::optional<ResourceUsage> finalUsage;
+        // transient only: first and last live pass and the aliasing slot backing the image
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        uint32_t slot = UINT32_MAX;
+    };
+    struct Buffer {
+        const char* name;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        std::optional<ResourceUsage> finalUsage;
+    };
+    struct Use {
+        uint32_t resource;
+        bool image;
+        ResourceUsage usage;
+    };
+    struct Pass {
+        const char* name;
+        std::function<void(VkCommandBuffer&)> record;
+        // kept even when nothing reads its outputs, e.g. copies the host consumes
+        bool sideEffect;
+        std::vector<Use> uses;
+        bool culled = false;
+        std::vector<VkImageMemoryBarrier2> imageBarriers;
+        std::vector<uint32_t> imageBarrierResources;
+        std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+        std::vector<uint32_t> bufferBarrierResources;
+    };
+    struct Slot {
+        VkMemoryRequirements memRequirements;
+        uint32_t lastPass;
+        Allocation memory;
+    };
+
+    uint32_t importImage(const char* name, VkImageAspectFlags aspectMask, VkImageLayout initialLayout,
+        VkPipelineStageFlags2 initialStage, std::optional<ResourceUsage> finalUsage);
+    void setImportedImage(uint32_t handle, VkImage image, VkImageView view);
+    uint32_t createImage(const char* name, ImageDesc desc);
+    uint32_t importBuffer(const char* name, std::optional<ResourceUsage> finalUsage);
+    void setImportedBuffer(uint32_t handle, VkBuffer buffer);
+    uint32_t addPass(const char* name, std::function<void(VkCommandBuffer&)> record, bool sideEffect = false);
+    void useImage(uint32_t pass, uint32_t image, ResourceUsage usage);
+    void useBuffer(uint32_t pass, uint32_t buffer, ResourceUsage usage);
+    VkImageView getView(uint32_t image) { return images[image].view; }
+
+    void compile(VkDevice dev, MemoryAllocator& memAllocator);
+    void execute(VkCommandBuffer& cmdBuffer);
+    // destroys transient images and forgets every pass and resource
+    void reset();
+
+    void cullPasses();
+    void allocateTransients();
+    void buildBarriers();
+    // updates the tracked state for `usage` and reports whether a barrier is needed before it
+    bool addBarrier(ResourceState& state, ResourceUsage usage, bool image, VkPipelineStageFlags2& srcStage, 
+        VkAccessFlags2& srcAccess, VkImageLayout& oldLayout);
+    void buildPassBarriers(Pass& pass, const std::vector<Use>& uses, std::vector<ResourceState>& imageStates,
+        std::vector<ResourceState>& bufferStates);
+    void recordBarriers(Pass& pass, VkCommandBuffer& cmdBuffer);
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    std::vector<Image> images;
+    std::vector<Buffer> buffers;
+    std::vector<Pass> passes;
+    std::vector<Slot> slots;
+    // barriers into the final usage of imported resources, recorded after the last pass
+    Pass finalBarriers{.name = "final barriers", .record = nullptr, .sideEffect = false};
+    uint32_t culledPassCount = 0;
+    VkDeviceSize transientBytes = 0;
+    VkDeviceSize aliasedBytes = 0;
+};
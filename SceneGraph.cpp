@@ -0,0 +1,127 @@
+#include "SceneGraph.hpp"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// below this many nodes a level is updated on the calling thread
+constexpr size_t SCENE_CHUNK_NODES = 4096;
+
+glm::mat4 composeTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    glm::mat3 basis = glm::mat3_cast(rotation);
+    return glm::mat4(
+        glm::vec4(basis[0]*scale.x, 0.0f),
+        glm::vec4(basis[1]*scale.y, 0.0f),
+        glm::vec4(basis[2]*scale.z, 0.0f),
+        glm::vec4(translation, 1.0f));
+}
+
+}
+
+void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#if defined(__x86_64__)
+    // every column of the result is a combination of a's columns weighted by b's column
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for (int column=0; column<4; column++) {
+        __m128 result = _mm_mul_ps(a0, _mm_set1_ps(b[column][0]));
+        result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(b[column][1])));
+        result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(b[column][2])));
+        result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(b[column][3])));
+        _mm_storeu_ps(&out[column][0], result);
+    }
+#else
+    out = a*b;
+#endif
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    if (parent != NO_PARENT && parent >= size()) {
+        throw std::runtime_error("VK Error: scene node added before its parent");
+    }
+    translations.push_back(translation);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    parents.push_back(parent);
+    depths.push_back(parent == NO_PARENT ? 0 : depths[parent] + 1);
+    worldMatrices.push_back(glm::mat4(1.0f));
+    dirty.push_back(1);
+    worldChanged.push_back(0);
+    levelsValid = false;
+    return (uint32_t)size() - 1;
+}
+void SceneGraph::setTranslation(uint32_t node, const glm::vec3& translation) {
+    translations[node] = translation;
+    dirty[node] = 1;
+}
+void SceneGraph::setRotation(uint32_t node, const glm::quat& rotation) {
+    rotations[node] = rotation;
+    dirty[node] = 1;
+}
+void SceneGraph::setScale(uint32_t node, const glm::vec3& scale) {
+    scales[node] = scale;
+    dirty[node] = 1;
+}
+void SceneGraph::buildLevels() {
+    // counting sort by depth, stable so each level keeps the nodes in memory order
+    uint32_t levelCount = 0;
+    for (uint32_t depth: depths) {
+        levelCount = std::max(levelCount, depth + 1);
+    }
+    levelStarts.assign(levelCount + 1, 0);
+    for (uint32_t depth: depths) {
+        levelStarts[depth + 1]++;
+    }
+    for (uint32_t level=0; level<levelCount; level++) {
+        levelStarts[level + 1] += levelStarts[level];
+    }
+    levelNodes.resize(size());
+    std::vector<uint32_t> cursors(levelStarts.begin(), levelStarts.end() - 1);
+    for (uint32_t node=0; node<size(); node++) {
+        levelNodes[cursors[depths[node]]++] = node;
+    }
+    levelsValid = true;
+}
+void SceneGraph::update(ThreadPool* pool) {
+    if (!levelsValid) {
+        buildLevels();
+    }
+    std::atomic<uint32_t> updated = 0;
+    // a level only reads the world matrices of the one before it, so its nodes are independent
+    auto updateNodes = [&](size_t begin, size_t end) {
+        uint32_t count = 0;
+        for (size_t i=begin; i<end; i++) {
+            uint32_t node = levelNodes[i];
+            uint32_t parent = parents[node];
+            bool changed = dirty[node] || (parent != NO_PARENT && worldChanged[parent]);
+            worldChanged[node] = changed;
+            if (!changed) {
+                continue;
+            }
+            glm::mat4 local = composeTransform(translations[node], rotations[node], scales[node]);
+            if (parent == NO_PARENT) {
+                worldMatrices[node] = local;
+            } else {
+                multiplyMatrices(worldMatrices[parent], local, worldMatrices[node]);
+            }
+            dirty[node] = 0;
+            count++;
+        }
+        updated += count;
+    };
+    for (size_t level=0; level+1<levelStarts.size(); level++) {
+        size_t begin = levelStarts[level];
+        size_t count = levelStarts[level + 1] - begin;
+        if (pool == nullptr) {
+            updateNodes(begin, begin + count);
+            continue;
+        }
+        pool->parallelFor(count, SCENE_CHUNK_NODES, [&](size_t chunkBegin, size_t chunkEnd) {
+            updateNodes(begin + chunkBegin, begin + chunkEnd);
+        });
+    }
+    updatedCount = updated;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "config.hpp"
+#include "ThreadPool.hpp"
+
+// Transform hierarchy in structure-of-arrays form. A node's parent always has a lower index,
+// so every node can be appended without reordering; update() walks the nodes level by level,
+// splitting each level across the pool, and only recomputes the world matrices of nodes whose
+// local transform or any ancestor changed.
+struct SceneGraph {
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    uint32_t addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    void setTranslation(uint32_t node, const glm::vec3& translation);
+    void setRotation(uint32_t node, const glm::quat& rotation);
+    void setScale(uint32_t node, const glm::vec3& scale);
+    void update(ThreadPool* pool = nullptr);
+    void buildLevels();
+    size_t size() const { return parents.size(); }
+
+    // local TRS, written by the setters
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> depths;
+    std::vector<glm::mat4> worldMatrices;
+    // local transform changed since the last update
+    std::vector<uint8_t> dirty;
+    // world matrix recomputed by the last update, read by the children on the next level
+    std::vector<uint8_t> worldChanged;
+    // node indices grouped by depth, levelStarts[d] is the first node of depth d
+    std::vector<uint32_t> levelNodes;
+    std::vector<uint32_t> levelStarts;
+    bool levelsValid = false;
+    uint32_t updatedCount = 0;
+};
+
+// out = a*b for column-major matrices, with SSE on x86-64
+void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
@@ -0,0 +1,38 @@
+#include "SlotAllocator.hpp"
+
+void SlotAllocator::init(uint32_t slotCount) {
+    capacity = slotCount;
+    nextSlot = 0;
+    freeSlots.clear();
+    retiredSlots.clear();
+    usedCount = 0;
+    peakUsedCount = 0;
+}
+uint32_t SlotAllocator::allocate() {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        // kept as a min-heap so the live slots stay packed at the front of the array
+        std::pop_heap(freeSlots.begin(), freeSlots.end(), std::greater<uint32_t>());
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else if (nextSlot < capacity) {
+        slot = nextSlot++;
+    } else {
+        throw std::runtime_error("VK Error: out of descriptor slots, " + std::to_string(capacity) + " in use or retiring");
+    }
+    usedCount++;
+    peakUsedCount = std::max(peakUsedCount, usedCount);
+    return slot;
+}
+void SlotAllocator::retire(uint32_t slot, uint64_t timelineValue) {
+    // values only grow, so the queue stays sorted
+    retiredSlots.emplace_back(timelineValue, slot);
+    usedCount--;
+}
+void SlotAllocator::collect(uint64_t completedValue) {
+    while (!retiredSlots.empty() && retiredSlots.front().first <= completedValue) {
+        freeSlots.push_back(retiredSlots.front().second);
+        std::push_heap(freeSlots.begin(), freeSlots.end(), std::greater<uint32_t>());
+        retiredSlots.pop_front();
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+
+// Indices into a fixed size descriptor array. A released slot may still be read by frames in
+// flight, so it is retired with the timeline value of the last frame that may read it and only handed
+// out again once collect() sees the timeline pass that value.
+struct SlotAllocator {
+    void init(uint32_t slotCount);
+    // lowest recycled slot first, throws when every slot is taken or still retiring
+    uint32_t allocate();
+    void retire(uint32_t slot, uint64_t timelineValue);
+    void collect(uint64_t completedValue);
+
+    uint32_t capacity = 0;
+    // slots from here on were never handed out
+    uint32_t nextSlot = 0;
+    std::vector<uint32_t> freeSlots;
+    std::deque<std::pair<uint64_t, uint32_t>> retiredSlots;
+    uint32_t usedCount = 0;
+    uint32_t peakUsedCount = 0;
+};
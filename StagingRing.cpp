@@ -0,0 +1,60 @@
+#include "StagingRing.hpp"
+
+void StagingRing::init(VkDevice dev, MemoryAllocator& allocator, VkDeviceSize ringSize) {
+    device = dev;
+    capacity = ringSize;
+    VkBufferCreateInfo bufferCI{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .size = capacity,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr
+    };
+    VK_CHECK(vkCreateBuffer(device, &bufferCI, nullptr, &buffer));
+    memory = allocator.allocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
+void StagingRing::destroy(MemoryAllocator& allocator) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator.free(memory);
+    submissions.clear();
+}
+std::optional<StagingRegion> StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if (size > capacity) {
+        return std::nullopt;
+    }
+    if (usedBytes == 0) {
+        head = 0;
+    }
+    VkDeviceSize offset = (head + alignment - 1)/alignment*alignment;
+    if (offset + size > capacity) {
+        offset = 0;
+    }
+    VkDeviceSize consumed = (offset >= head ? offset - head : capacity - head + offset) + size;
+    if (usedBytes + consumed > capacity) {
+        return std::nullopt;
+    }
+    usedBytes += consumed;
+    pendingBytes += consumed;
+    head = offset + size;
+    return StagingRegion{
+        .buffer = buffer,
+        .offset = offset,
+        .data = static_cast<char*>(memory.mapped) + offset
+    };
+}
+void StagingRing::tag(uint64_t timelineValue) {
+    if (pendingBytes == 0) {
+        return;
+    }
+    submissions.push_back(Submission{.bytes = pendingBytes, .timelineValue = timelineValue});
+    pendingBytes = 0;
+}
+void StagingRing::retire(uint64_t completedValue) {
+    while (!submissions.empty() && submissions.front().timelineValue <= completedValue) {
+        usedBytes -= submissions.front().bytes;
+        submissions.pop_front();
+    }
+}
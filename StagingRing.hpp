@@ -0,0 +1,39 @@
+#pragma once
+#include "config.hpp"
+#include "common.hpp"
+#include "Allocator.hpp"
+
+struct StagingRegion {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void* data;
+};
+
+// One persistently mapped upload buffer used as a ring. Space handed out since the last
+// tag() belongs to the next upload submit and is reclaimed once the timeline passes its value.
+struct StagingRing {
+    struct Submission {
+        VkDeviceSize bytes;
+        uint64_t timelineValue;
+    };
+
+    void init(VkDevice dev, MemoryAllocator& allocator, VkDeviceSize ringSize);
+    void destroy(MemoryAllocator& allocator);
+    // nullopt when the ring has no room until earlier uploads retire
+    std::optional<StagingRegion> allocate(VkDeviceSize size, VkDeviceSize alignment);
+    void tag(uint64_t timelineValue);
+    void retire(uint64_t completedValue);
+    bool hasPending() { return pendingBytes > 0; }
+    // value to wait on to free the oldest space, 0 when nothing is in flight
+    uint64_t getOldestValue() { return submissions.empty() ? 0 : submissions.front().timelineValue; }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation memory;
+    VkDeviceSize capacity = 0;
+    VkDeviceSize head = 0;
+    // bytes not yet reclaimed, including the space skipped when wrapping
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize pendingBytes = 0;
+    std::deque<Submission> submissions;
+};
@@ -0,0 +1,83 @@
+#include "ThreadPool.hpp"
+
+void ThreadPool::start(uint32_t threadCount) {
+    stopping = false;
+    for (uint32_t i=0; i<std::max(threadCount, 1u); i++) {
+        threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+void ThreadPool::stop() {
+    if (threads.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+        pendingJobs++;
+    }
+    queueChanged.notify_one();
+}
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [&] { return pendingJobs == 0; });
+    if (error) {
+        std::exception_ptr jobError = error;
+        error = nullptr;
+        std::rethrow_exception(jobError);
+    }
+}
+void ThreadPool::parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& job) {
+    // a few chunks per thread even out the load
+    size_t chunkCount = std::min<size_t>(threads.size()*4, count/std::max<size_t>(minChunk, 1));
+    if (chunkCount <= 1 || threads.size() < 2) {
+        if (count > 0) {
+            job(0, count);
+        }
+        return;
+    }
+    size_t chunkSize = (count + chunkCount - 1)/chunkCount;
+    for (size_t begin=0; begin<count; begin+=chunkSize) {
+        size_t end = std::min(begin + chunkSize, count);
+        submit([&job, begin, end] { job(begin, end); });
+    }
+    wait();
+}
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        std::exception_ptr jobError;
+        try {
+            job();
+        } catch (...) {
+            jobError = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobError && !error) {
+                error = jobError;
+            }
+            pendingJobs--;
+        }
+        jobsDone.notify_all();
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "config.hpp"
+
+// Fixed set of worker threads draining one shared job queue. wait() blocks until every job
+// submitted so far has finished; an exception thrown by a job is rethrown from wait().
+struct ThreadPool {
+    // joins the workers when an exception unwinds past a started pool
+    ~ThreadPool() { stop(); }
+    void start(uint32_t threadCount);
+    // finishes the queued jobs and joins the workers, does nothing when they aren't running
+    void stop();
+    void submit(std::function<void()> job);
+    void wait();
+    // splits [0, count) into chunks of at least minChunk items, runs them on the pool and waits,
+    // runs inline when there is only one chunk
+    void parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& job);
+    void work();
+    uint32_t getThreadCount() { return (uint32_t)threads.size(); }
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::condition_variable jobsDone;
+    std::deque<std::function<void()>> queue;
+    // queued plus running jobs
+    uint32_t pendingJobs = 0;
+    std::exception_ptr error;
+    bool stopping = false;
+};
@@ -0,0 +1,241 @@
+#include "Engine.hpp"
+
+// Renders a synthetic scene headless with a fixed simulated clock and writes frame time,
+// command recording time and memory statistics as CSV or JSON. Comparing vertex formats is
+// best done with many triangles at a small resolution, so the vertex stage dominates GPU time.
+// Draw paths are compared with many draws of few triangles, where recording time dominates.
+// Levels of detail are compared with many draws of many triangles, growing --draws with LODs on
+// should leave the triangles per frame roughly flat. Mipmaps are compared on minified views, textures
+// much larger than the objects they cover on screen (--texture-size 1024 with many draws), where
+// sampling level 0 spreads every quad's texels over far more cache lines than it reads.
+// --texture-churn streams textures in and out every frame, each one replacing the texture of
+// the next material in turn, so the bindless slots are recycled while frames are in flight.
+struct BenchResult {
+    std::vector<double> frameMs;
+    std::vector<double> recordMs;
+    double gpuAvgMs;
+    VkDeviceSize peakDeviceMemoryBytes;
+    VkDeviceSize vertexBufferBytes;
+    bool gpuCulling;
+    double trianglesPerFrame;
+    double fullDetailTrianglesPerFrame;
+    double drawPacketsPerFrame;
+    double stateChangesPerFrame;
+    double stateChangesAvoidedPerFrame;
+    double drawSortMs;
+    uint64_t textureBytes;
+    uint64_t rgba8TextureBytes;
+    double cpuMipMs;
+    double textureDecodeMs;
+    uint32_t peakTextureSlots;
+    uint64_t peakHostMemoryKb;
+};
+
+uint64_t getPeakHostMemoryKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoull(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    EngineConfig config;
+    config.headless = true;
+    config.validation = false;
+    config.fixedTimestep = 1.0f/60.0f;
+    SyntheticScene scene;
+    uint32_t frameCount = 1000;
+    uint32_t warmupFrames = 16;
+    uint32_t textureChurn = 0;
+    std::string format = "csv";
+    std::string outputPath;
+    for (int i=1; i+1<argc; i+=2) {
+        std::string arg = argv[i];
+        std::string value = argv[i+1];
+        if (arg == "--frames") {
+            frameCount = (uint32_t)std::stoul(value);
+        } else if (arg == "--warmup") {
+            warmupFrames = (uint32_t)std::stoul(value);
+        } else if (arg == "--draws") {
+            scene.drawCount = (uint32_t)std::stoul(value);
+        } else if (arg == "--triangles") {
+            scene.triangleCount = (uint32_t)std::stoul(value);
+        } else if (arg == "--textures") {
+            // every material samples a texture, and instances pick materials modulo their count
+            scene.textureCount = (uint32_t)std::stoul(value);
+            if (scene.textureCount == 0) {
+                std::cerr << "--textures needs at least 1 texture" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--texture-size") {
+            scene.textureSize = (uint32_t)std::stoul(value);
+        } else if (arg == "--texture") {
+            config.texturePaths.push_back(value);
+        } else if (arg == "--texture-churn") {
+            textureChurn = (uint32_t)std::stoul(value);
+        } else if (arg == "--width") {
+            config.width = (uint32_t)std::stoul(value);
+        } else if (arg == "--height") {
+            config.height = (uint32_t)std::stoul(value);
+        } else if (arg == "--vertex-format") {
+            if (value != "float" && value != "quantized") {
+                std::cerr << "Unknown vertex format " << value << std::endl;
+                return 1;
+            }
+            config.quantizeVertices = value == "quantized";
+        } else if (arg == "--draw-path") {
+            if (value != "cpu" && value != "gpu") {
+                std::cerr << "Unknown draw path " << value << std::endl;
+                return 1;
+            }
+            config.gpuCulling = value == "gpu";
+        } else if (arg == "--lods") {
+            if (value != "on" && value != "off") {
+                std::cerr << "Unknown lod mode " << value << std::endl;
+                return 1;
+            }
+            config.lods = value == "on";
+        } else if (arg == "--mipmaps") {
+            if (value != "off" && value != "blit" && value != "box" && value != "kaiser") {
+                std::cerr << "Unknown mipmap mode " << value << std::endl;
+                return 1;
+            }
+            config.mipmaps = value != "off";
+            if (value == "box" || value == "kaiser") {
+                config.cpuMipFilter = value == "box" ? MipFilter::Box : MipFilter::Kaiser;
+            }
+        } else if (arg == "--lod-error-pixels") {
+            config.lodErrorPixels = std::stof(value);
+        } else if (arg == "--format") {
+            format = value;
+        } else if (arg == "--output") {
+            outputPath = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    config.syntheticScene = scene;
+
+    BenchResult result;
+    {
+        Engine engine(config);
+        engine.waitUploads();
+        for (uint32_t frame=0; frame<warmupFrames; frame++) {
+            engine.renderFrame();
+        }
+        vkDeviceWaitIdle(engine.device);
+        engine.gpuTimeStats[0] = TimingStats{};
+        engine.lodStats = LodStats{};
+        engine.drawStats = DrawStats{};
+        // one flat color per streamed texture, the upload size is what matters
+        std::vector<uint32_t> churnPixels((size_t)scene.textureSize*scene.textureSize);
+        uint32_t churnMaterial = 0;
+        for (uint32_t frame=0; frame<frameCount; frame++) {
+            auto frameStart = std::chrono::high_resolution_clock::now();
+            for (uint32_t i=0; i<textureChurn; i++) {
+                Material& material = engine.materials[churnMaterial];
+                churnMaterial = (churnMaterial+1)%(uint32_t)engine.materials.size();
+                engine.unloadTexture(material.textureIndex);
+                std::fill(churnPixels.begin(), churnPixels.end(), 0xff000000 | ((frame*0x9e3779b9u + i) & 0x00ffffff));
+                material.textureIndex = engine.loadTexture(churnPixels.data(), scene.textureSize, scene.textureSize);
+            }
+            engine.renderFrame();
+            result.frameMs.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - frameStart).count());
+            result.recordMs.push_back(engine.lastRecordMs);
+        }
+        vkDeviceWaitIdle(engine.device);
+        for (uint32_t i=0; i<engine.MAX_FRAMES_IN_FLIGHT; i++) {
+            engine.collectGpuTime(i);
+        }
+        const TimingStats& gpu = engine.gpuTimeStats[0];
+        result.gpuAvgMs = gpu.frames ? gpu.totalMs/gpu.frames : 0.0;
+        result.peakDeviceMemoryBytes = engine.allocator.getStats().peakBytesReserved;
+        result.vertexBufferBytes = engine.vertexBufferSize;
+        // the GPU path silently falls back on devices without drawIndirectFirstInstance
+        result.gpuCulling = engine.gpuCulling;
+        const LodStats& lods = engine.lodStats;
+        result.trianglesPerFrame = lods.frames ? (double)lods.triangles/lods.frames : 0.0;
+        result.fullDetailTrianglesPerFrame = lods.frames ? (double)lods.fullDetailTriangles/lods.frames : 0.0;
+        const DrawStats& draws = engine.drawStats;
+        result.drawPacketsPerFrame = draws.frames ? (double)draws.packets/draws.frames : 0.0;
+        result.stateChangesPerFrame = draws.frames ? (double)draws.stateChanges/draws.frames : 0.0;
+        result.stateChangesAvoidedPerFrame = draws.frames ? (double)draws.stateChangesAvoided/draws.frames : 0.0;
+        result.drawSortMs = draws.frames ? draws.sortMs/draws.frames : 0.0;
+        result.textureBytes = engine.textureStats.bytes;
+        result.rgba8TextureBytes = engine.textureStats.rgba8Bytes;
+        result.cpuMipMs = engine.textureStats.cpuMipMs;
+        result.textureDecodeMs = engine.textureStats.decodeMs;
+        result.peakTextureSlots = engine.textureSlots.peakUsedCount;
+    }
+    result.peakHostMemoryKb = getPeakHostMemoryKb();
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+    }
+    std::ostream& out = outputPath.empty() ? std::cout : file;
+    std::vector<std::pair<std::string, double>> fields = {
+        {"frames", frameCount},
+        {"draws", scene.drawCount},
+        {"triangles", scene.triangleCount},
+        {"textures", config.texturePaths.empty() ? scene.textureCount : config.texturePaths.size()},
+        {"width", config.width},
+        {"height", config.height},
+        {"frame_p50_ms", percentile(result.frameMs, 0.5)},
+        {"frame_p95_ms", percentile(result.frameMs, 0.95)},
+        {"frame_p99_ms", percentile(result.frameMs, 0.99)},
+        {"record_p50_ms", percentile(result.recordMs, 0.5)},
+        {"record_p95_ms", percentile(result.recordMs, 0.95)},
+        {"record_p99_ms", percentile(result.recordMs, 0.99)},
+        {"quantized_vertices", config.quantizeVertices ? 1.0 : 0.0},
+        {"gpu_culling", result.gpuCulling ? 1.0 : 0.0},
+        {"lods", config.lods ? 1.0 : 0.0},
+        {"lod_error_pixels", config.lodErrorPixels},
+        // before culling, at the selected levels of detail and at full detail
+        {"triangles_per_frame", result.trianglesPerFrame},
+        {"full_detail_triangles_per_frame", result.fullDetailTrianglesPerFrame},
+        {"mipmaps", config.mipmaps ? 1.0 : 0.0},
+        // 0 when the chains are blitted on the GPU, otherwise 1 box and 2 kaiser
+        {"cpu_mip_filter", config.cpuMipFilter.has_value() ? 1.0 + (double)config.cpuMipFilter.value() : 0.0},
+        {"cpu_mip_ms", result.cpuMipMs},
+        {"texture_bytes", (double)result.textureBytes},
+        // the same textures stored as RGBA8, and the time spent decoding formats the device can't sample
+        {"rgba8_texture_bytes", (double)result.rgba8TextureBytes},
+        {"texture_decode_ms", result.textureDecodeMs},
+        {"texture_churn", textureChurn},
+        {"peak_texture_slots", result.peakTextureSlots},
+        {"draw_packets_per_frame", result.drawPacketsPerFrame},
+        {"state_changes_per_frame", result.stateChangesPerFrame},
+        {"state_changes_avoided_per_frame", result.stateChangesAvoidedPerFrame},
+        {"draw_sort_ms", result.drawSortMs},
+        {"gpu_avg_ms", result.gpuAvgMs},
+        // triangles submitted per second of GPU time
+        {"gpu_mtri_per_s", result.gpuAvgMs > 0.0 ? result.trianglesPerFrame/result.gpuAvgMs/1e3 : 0.0},
+        {"vertex_buffer_bytes", (double)result.vertexBufferBytes},
+        {"peak_device_memory_bytes", (double)result.peakDeviceMemoryBytes},
+        {"peak_host_memory_kb", (double)result.peakHostMemoryKb}
+    };
+    if (format == "json") {
+        out << "{";
+        for (size_t i=0; i<fields.size(); i++) {
+            out << (i==0 ? "" : ", ") << "\"" << fields[i].first << "\": " << fields[i].second;
+        }
+        out << "}" << std::endl;
+    } else {
+        for (size_t i=0; i<fields.size(); i++) {
+            out << (i==0 ? "" : ",") << fields[i].first;
+        }
+        out << "\n";
+        for (size_t i=0; i<fields.size(); i++) {
+            out << (i==0 ? "" : ",") << fields[i].second;
+        }
+        out << std::endl;
+    }
+    return 0;
+}
@@ -3,6 +3,9 @@
 
 inline std::vector<char> readFile(std::string filename) {
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("VK Error: cannot open " + filename);
+    }
     size_t fileSize = file.tellg();
     std::vector<char> buff(fileSize);
     file.seekg(0);
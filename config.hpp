@@ -1,9 +1,22 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <array>
 #include <set>
+#include <map>
 #include <optional>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <cstring>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vk_enum_string_helper.h>
 #define GLFW_INCLUDE_VULKAN
@@ -11,5 +24,6 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <chrono>
 #include <stb_image.h>
\ No newline at end of file
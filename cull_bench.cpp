@@ -0,0 +1,62 @@
+#include "Culling.hpp"
+#include "MicroBench.hpp"
+#include <random>
+
+// CPU frustum culling throughput at 10k, 100k and 1M objects for every kernel the CPU supports,
+// single threaded and on a ThreadPool. Objects are scattered around a camera looking down one
+// axis, so roughly a fifth of them survive, as in an open scene.
+
+int main(int argc, char** argv) {
+    MicroBench bench;
+    if (!bench.parseArgs(argc, argv, "--objects")) {
+        return 1;
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f/9.0f, 0.1f, 500.0f);
+    proj[1][1]*=-1;
+    Frustum frustum = getFrustum(proj*view);
+
+    std::vector<CullKernel> kernels = {CullKernel::Scalar};
+    if (getCullKernel() != CullKernel::Scalar) {
+        kernels.push_back(CullKernel::Sse);
+    }
+    if (getCullKernel() == CullKernel::Avx2) {
+        kernels.push_back(CullKernel::Avx2);
+    }
+
+    bench.begin("objects", {"shape", "kernel"}, "visible");
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.1f, 5.0f);
+    for (size_t objectCount: bench.counts) {
+        SphereBounds spheres;
+        BoxBounds boxes;
+        spheres.resize(objectCount);
+        boxes.resize(objectCount);
+        for (size_t i=0; i<objectCount; i++) {
+            float center[3] = {position(rng), position(rng), position(rng)*0.1f};
+            float extent = size(rng);
+            float min[3] = {center[0] - extent, center[1] - extent, center[2] - extent};
+            float max[3] = {center[0] + extent, center[1] + extent, center[2] + extent};
+            spheres.set(i, center, extent*std::sqrt(3.0f));
+            boxes.set(i, min, max);
+        }
+        std::vector<uint32_t> visible;
+        for (const char* shape: {"sphere", "box"}) {
+            for (CullKernel kernel: kernels) {
+                for (ThreadPool* threads: {(ThreadPool*)nullptr, &bench.pool}) {
+                    BenchTiming timing = bench.time([&] {
+                        if (shape[0] == 's') {
+                            cullSpheres(spheres, frustum, visible, threads, kernel);
+                        } else {
+                            cullBoxes(boxes, frustum, visible, threads, kernel);
+                        }
+                    });
+                    bench.writeRow(objectCount, {shape, getCullKernelName(kernel)}, threads, timing, visible.size());
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,7 +1,68 @@
 #include "Engine.hpp"
 
-int main() {
-    Engine engine;
-    engine.run();
+int main(int argc, char** argv) {
+    EngineConfig config;
+    uint32_t frameCount = 0;
+    std::string readbackDirectory;
+    std::string tracePath;
+    std::string meshPackOutput;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless" && i+1 < argc) {
+            config.headless = true;
+            frameCount = (uint32_t)std::stoul(argv[++i]);
+        } else if (arg == "--readback" && i+1 < argc) {
+            readbackDirectory = argv[++i];
+        } else if (arg == "--profile" && i+1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--mesh" && i+1 < argc) {
+            config.meshPaths.push_back(argv[++i]);
+        } else if (arg == "--mesh-pack" && i+1 < argc) {
+            config.meshPackPath = argv[++i];
+        } else if (arg == "--write-mesh-pack" && i+1 < argc) {
+            meshPackOutput = argv[++i];
+        } else if (arg == "--quantize-vertices") {
+            config.quantizeVertices = true;
+        } else if (arg == "--cpu-draws") {
+            config.gpuCulling = false;
+        } else if (arg == "--no-lods") {
+            config.lods = false;
+        } else if (arg == "--no-mipmaps") {
+            config.mipmaps = false;
+        } else if (arg == "--cpu-mips") {
+            config.cpuMipFilter = MipFilter::Kaiser;
+        } else if (arg == "--texture" && i+1 < argc) {
+            config.texturePaths.push_back(argv[++i]);
+        } else if (arg == "--no-validation") {
+            config.validation = false;
+        } else if (arg == "--discrete-only") {
+            config.devicePolicy = DevicePolicy::DiscreteOnly;
+        }
+    }
+    if (!meshPackOutput.empty()) {
+        // offline conversion: parse the --mesh files once and exit
+        ThreadPool pool;
+        pool.start(std::thread::hardware_concurrency());
+        MeshLoadStats stats;
+        writeMeshPack(meshPackOutput, loadMeshes(config.meshPaths, pool, stats), config.quantizeVertices);
+        pool.stop();
+        std::cout << "Packed " << stats.fileCount << " meshes (" << stats.triangles << " triangles) into " 
+            << meshPackOutput << std::endl;
+        return 0;
+    }
+    Engine engine(config);
+    if (!readbackDirectory.empty()) {
+        engine.enableReadback(createPPMSink(readbackDirectory));
+    }
+    engine.profiler.enabled = !tracePath.empty();
+    if (config.headless) {
+        engine.renderFrames(frameCount);
+    } else {
+        engine.run();
+    }
+    if (!tracePath.empty()) {
+        engine.profiler.writeChromeTrace(tracePath);
+        engine.profiler.printStats();
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,12 +1,32 @@
 #version 460
+#extension GL_EXT_buffer_reference: require
+#extension GL_EXT_scalar_block_layout: require
+#extension GL_EXT_nonuniform_qualifier: require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 uv;
+layout(location = 2) flat in uint materialIndex;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+// GpuMaterial
+struct Material {
+    vec4 baseColor;
+    uint textureSlot;
+};
+layout(buffer_reference, scalar) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+// only materialBufferAddress of PushConstants, the rest is read by render.vert
+layout(push_constant, scalar) uniform PushConstants {
+    layout(offset = 40) MaterialBuffer materialBuffer;
+};
+
+// bindless: one array of every loaded texture, indexed by the material's slot
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 void main() {
-    outColor = texture(textureSampler, uv);
-}
\ No newline at end of file
+    Material material = materialBuffer.materials[materialIndex];
+    // neighbouring instances in a draw may use different materials
+    outColor = texture(textures[nonuniformEXT(material.textureSlot)], uv) * material.baseColor;
+}
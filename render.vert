@@ -4,35 +4,121 @@
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 uv;
+layout(location = 2) flat out uint materialIndex;
 
 struct Vertex {
     float vx, vy, vz;
     float nx, ny, nz;
     float u, v;
 };
+// PackedVertex as 32 bit words so no 16 bit storage feature is needed:
+// unorm16 xy | unorm16 z + pad | octahedral snorm16 normal | unorm16 or half uv
+struct PackedVertex {
+    uint positionXY;
+    uint positionZ;
+    uint normal;
+    uint uv;
+};
 // "buffer_reference" means we are defining a pointer type
 // "scalar" means we are aligning everything based on its scalar components
 layout(buffer_reference, scalar) readonly buffer VertexBuffer {
     Vertex vertices[];
 };
+layout(buffer_reference, scalar) readonly buffer PackedVertexBuffer {
+    PackedVertex vertices[];
+};
+// GpuObject, GpuInstance and MeshRange
+struct Object {
+    vec3 boundsCenter;
+    float boundsRadius;
+    uint meshIndex;
+    uint batch;
+};
+struct Instance {
+    // rows of the affine model matrix
+    vec4 transform[3];
+    uint materialIndex;
+    uint lod;
+};
+const uint MAX_MESH_LODS = 4;
+struct MeshLod {
+    uint firstIndex;
+    uint indexCount;
+    float error;
+};
+struct Mesh {
+    int vertexOffset;
+    uint vertexCount;
+    uint vertexFormat;
+    uint indexSize;
+    vec3 positionOffset;
+    vec3 positionScale;
+    vec3 boundsCenter;
+    float boundsRadius;
+    uint lodCount;
+    MeshLod lods[MAX_MESH_LODS];
+};
+layout(buffer_reference, scalar) readonly buffer ObjectBuffer {
+    Object objects[];
+};
+layout(buffer_reference, scalar) readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+layout(buffer_reference, scalar) readonly buffer MeshBuffer {
+    Mesh meshes[];
+};
+layout(buffer_reference, scalar) readonly buffer VisibleInstanceBuffer {
+    uint indices[];
+};
+// values of VertexFormat
+const uint VERTEX_FORMAT_FLOAT32 = 0;
+const uint VERTEX_FORMAT_QUANTIZED = 1;
+const uint VERTEX_FORMAT_QUANTIZED_HALF_UV = 2;
 layout(push_constant, scalar) uniform PushConstants {
     VertexBuffer vertexBuffer;
+    ObjectBuffer objectBuffer;
+    MeshBuffer meshBuffer;
+    InstanceBuffer instanceBuffer;
+    VisibleInstanceBuffer visibleInstances;
 };
 
 layout(set = 0, binding = 0) uniform MVP {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } mvp;
 
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = mvp.proj * mvp.view * mvp.model * vec4(
-        vertexBuffer.vertices[gl_VertexIndex].vx, 
-        vertexBuffer.vertices[gl_VertexIndex].vy, 
-        vertexBuffer.vertices[gl_VertexIndex].vz, 1.0);
-    fragColor = vec3(
-        vertexBuffer.vertices[gl_VertexIndex].nx, 
-        vertexBuffer.vertices[gl_VertexIndex].ny, 
-        vertexBuffer.vertices[gl_VertexIndex].nz);
-    uv = vec2(vertexBuffer.vertices[gl_VertexIndex].u, vertexBuffer.vertices[gl_VertexIndex].v);
-}
\ No newline at end of file
+    // gl_InstanceIndex counts from the batch's firstInstance into the list of visible instances
+    uint instanceIndex = visibleInstances.indices[gl_InstanceIndex];
+    Instance instance = instanceBuffer.instances[instanceIndex];
+    Mesh mesh = meshBuffer.meshes[objectBuffer.objects[instanceIndex].meshIndex];
+    vec3 position;
+    vec3 normal;
+    if (mesh.vertexFormat == VERTEX_FORMAT_FLOAT32) {
+        Vertex vertex = vertexBuffer.vertices[gl_VertexIndex];
+        position = vec3(vertex.vx, vertex.vy, vertex.vz);
+        normal = vec3(vertex.nx, vertex.ny, vertex.nz);
+        uv = vec2(vertex.u, vertex.v);
+    } else {
+        PackedVertex vertex = PackedVertexBuffer(vertexBuffer).vertices[gl_VertexIndex];
+        // positions are relative to the mesh bounds: offset is the minimum, scale the extent
+        vec3 quantized = vec3(unpackUnorm2x16(vertex.positionXY), unpackUnorm2x16(vertex.positionZ).x);
+        position = mesh.positionOffset + quantized*mesh.positionScale;
+        normal = decodeOctahedral(unpackSnorm2x16(vertex.normal));
+        uv = mesh.vertexFormat == VERTEX_FORMAT_QUANTIZED ? unpackUnorm2x16(vertex.uv) : unpackHalf2x16(vertex.uv);
+    }
+    vec4 modelPosition = vec4(position, 1.0);
+    vec4 worldPosition = vec4(dot(instance.transform[0], modelPosition), dot(instance.transform[1], modelPosition),
+        dot(instance.transform[2], modelPosition), 1.0);
+    gl_Position = mvp.proj * mvp.view * worldPosition;
+    fragColor = normal;
+    materialIndex = instance.materialIndex;
+}
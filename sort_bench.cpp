@@ -0,0 +1,45 @@
+#include "DrawList.hpp"
+#include "MicroBench.hpp"
+#include <random>
+
+// Draw list radix sort at 10k, 100k and 1M packets, single threaded and on a ThreadPool, next to
+// std::stable_sort. Keys spread over pipelines, states and depths, so every field has to be sorted.
+
+int main(int argc, char** argv) {
+    MicroBench bench;
+    if (!bench.parseArgs(argc, argv, "--packets")) {
+        return 1;
+    }
+
+    bench.begin("packets", {"sort"}, "passes");
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<uint32_t> pipeline(0, 15);
+    std::uniform_int_distribution<uint32_t> state(0, 4095);
+    std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+    for (size_t packetCount: bench.counts) {
+        DrawList unsorted;
+        for (size_t i=0; i<packetCount; i++) {
+            unsorted.push(makeSortKey(DrawPass::Opaque, pipeline(rng), state(rng), depth(rng)), (uint32_t)i);
+        }
+        for (const char* sort: {"radix", "std"}) {
+            for (ThreadPool* threads: {(ThreadPool*)nullptr, &bench.pool}) {
+                // std::stable_sort has no parallel version here
+                if (sort[0] == 's' && threads != nullptr) {
+                    continue;
+                }
+                DrawList list;
+                // copied outside the timing, the scratch buffer is kept between iterations like between frames
+                BenchTiming timing = bench.time([&] {
+                    if (sort[0] == 'r') {
+                        list.sort(threads);
+                    } else {
+                        std::stable_sort(list.packets.begin(), list.packets.end(),
+                            [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+                    }
+                }, [&] { list.packets = unsorted.packets; });
+                bench.writeRow(packetCount, {sort}, threads, timing, list.sortPasses);
+            }
+        }
+    }
+    return 0;
+}